@@ -0,0 +1,126 @@
+/*
+   Copyright 2017 Alessandro Pasqualini
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+     http://www.apache.org/licenses/LICENSE-2.0
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+
+   @author    Alessandro Pasqualini <alessandro.pasqualini.1105@gmail.com>
+   @url       https://github.com/alessandro1105
+
+   This project has been developed with the contribution of Futura Elettronica.
+   - http://www.futurashop.it
+   - http://www.elettronicain.it
+   - https://www.open-electronics.org
+*/
+
+#include <D7S.h>
+
+// Fishino32 interrupt pins
+#if defined(_FISHINO32_)
+  #define INT1_PIN 3 //interrupt pin INT1 of D7S attached to pin 3 of Fishino32
+  #define INT2_PIN 5 //interrupt pin INT2 of D7S attached to pin 5 of Fishino32
+// Esp8266 interrupt pins (tested on WeMos D1 R1)
+#elif defined(ESP8266)
+  #define INT1_PIN D7 //interrupt pin INT1 of D7S attached to pin D7 of ESP8266
+  #define INT2_PIN D8 //interrupt pin INT2 of D7S attached to pin D8 of ESP8266
+// Arduino UNO/Fishino UNO interrupt pins
+#else
+  #define INT1_PIN 2 //interrupt pin INT1 of D7S attached to pin 2 of Arduino
+  #define INT2_PIN 3 //interrupt pin INT2 of D7S attached to pin 3 of Arduino
+#endif
+
+#define NODE_ID 1 //id of this node written into each frame
+
+//buffer used to encode the frames (used only by loop())
+uint8_t frame[D7S_FRAME_MAX_SIZE];
+
+//events recorded by the handlers (they run in interrupt context, so they don't send anything)
+//bit 0 => START_EARTHQUAKE, bit 1 => END_EARTHQUAKE, bit 2 => SHUTOFF_EVENT, bit 3 => COLLAPSE_EVENT
+volatile uint8_t pendingEvents = 0;
+//copy of the lastest earthquake data (valid when END_EARTHQUAKE is pending)
+d7s_earthquake lastEarthquake;
+
+//--- EVENT HANDLERS --
+//function to handle start, shutoff and collapse events (the context is the bit of the event)
+void eventHandler(void *context) {
+  pendingEvents |= (uint8_t) (uintptr_t) context;
+}
+
+//function to handle the end of an earthquake (it copies the earthquake data)
+void endEarthquakeHandler(const d7s_earthquake &earthquake, void *context) {
+  lastEarthquake = earthquake;
+  pendingEvents |= (uint8_t) (uintptr_t) context;
+}
+
+
+void setup() {
+  // Open serial communications and wait for port to open:
+  Serial.begin(115200);
+  while (!Serial) {
+    ; // wait for serial port to connect. Needed for native USB port only
+  }
+
+  //--- STARTING ---
+  //start D7S connection resuming the D7S in the state it is (the installation is not repeated at every reboot)
+  D7S.setNodeId(NODE_ID);
+  d7s_warm_start result = D7S.warmStart();
+  //retry until the D7S is ready (the time to ready is measured from the first attempt)
+  while (result == WARM_START_BUSY || result == WARM_START_ERROR) {
+    delay(500);
+    result = D7S.warmStart();
+  }
+
+  //sending the status of the node (the interrupt handling is not started yet, so the bus is free)
+  Serial.write(frame, D7S.encodeStatusFrame(frame));
+
+  //--- INTERRUPT SETTINGS ---
+  //enabling interrupt INT1
+  D7S.enableInterruptINT1(INT1_PIN);
+  //enabling interrupt INT2
+  D7S.enableInterruptINT2(INT2_PIN);
+
+  //registering event handlers (the context is the bit of pendingEvents to set)
+  D7S.registerInterruptEventHandler(START_EARTHQUAKE, &eventHandler, (void *) 0x01); //START_EARTHQUAKE event handler
+  D7S.registerInterruptEventHandler(END_EARTHQUAKE, &endEarthquakeHandler, (void *) 0x02); //END_EARTHQUAKE event handler
+  D7S.registerInterruptEventHandler(SHUTOFF_EVENT, &eventHandler, (void *) 0x04); //SHUTOFF_EVENT event handler
+  D7S.registerInterruptEventHandler(COLLAPSE_EVENT, &eventHandler, (void *) 0x08); //COLLAPSE_EVENT event handler
+
+  //--- STARTING INTERRUPT HANDLING ---
+  D7S.startInterruptHandling();
+}
+
+void loop() {
+  //taking the events recorded by the handlers (and the earthquake data with them)
+  noInterrupts();
+  uint8_t events = pendingEvents;
+  pendingEvents = 0;
+  d7s_earthquake earthquake = lastEarthquake;
+  interrupts();
+
+  //sending the events (the frames are encoded without using the bus, which belongs to the interrupt handlers)
+  if (events & 0x01) {
+    Serial.write(frame, D7S.encodeEventFrame(frame, START_EARTHQUAKE));
+  }
+  if (events & 0x02) {
+    Serial.write(frame, D7S.encodeEarthquakeFrame(frame, earthquake));
+  }
+  if (events & 0x04) {
+    Serial.write(frame, D7S.encodeEventFrame(frame, SHUTOFF_EVENT));
+  }
+  if (events & 0x08) {
+    Serial.write(frame, D7S.encodeEventFrame(frame, COLLAPSE_EVENT));
+  }
+
+  //sending the statistics every hour
+  static unsigned long lastStatistics = 0;
+  if (millis() - lastStatistics >= 3600000UL) {
+    lastStatistics = millis();
+    Serial.write(frame, D7S.encodeStatisticsFrame(frame));
+  }
+}
@@ -0,0 +1,180 @@
+/*
+   Copyright 2017 Alessandro Pasqualini
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+     http://www.apache.org/licenses/LICENSE-2.0
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+
+   @author    Alessandro Pasqualini <alessandro.pasqualini.1105@gmail.com>
+   @url       https://github.com/alessandro1105
+
+   This project has been developed with the contribution of Futura Elettronica.
+   - http://www.futurashop.it
+   - http://www.elettronicain.it
+   - https://www.open-electronics.org
+*/
+
+//throughput of the ingest: the frames of a simulated fleet are generated in memory, then
+// - scan: a single scanner over the whole data (parser only)
+// - table: the streams are scanned by the workers into a shared NodeTable (parser and table)
+// - ingest: the streams are written to socket pairs and read by Ingest (the daemon path)
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <csignal>
+#include <getopt.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "d7s/fleet.h"
+#include "d7s/ingest.h"
+
+using Clock = std::chrono::steady_clock;
+
+static double seconds(Clock::time_point start) {
+   return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+static void result(const char *name, uint64_t frames, uint64_t bytes, double elapsed) {
+   printf("%-8s %10.1f MB/s %10.2f Mframes/s %12llu frames %8.3f s\n", name, bytes / elapsed / 1e6, frames / elapsed / 1e6,
+      (unsigned long long) frames, elapsed);
+}
+
+int main(int argc, char **argv) {
+   size_t megabytes = 64;
+   size_t streams = 16;
+   size_t nodes = 4096;
+   unsigned workers = std::thread::hardware_concurrency();
+   unsigned corrupt = 1;
+
+   int option;
+   while ((option = getopt(argc, argv, "m:k:n:w:c:h")) != -1) {
+      switch (option) {
+         case 'm': megabytes = strtoul(optarg, nullptr, 0); break;
+         case 'k': streams = strtoul(optarg, nullptr, 0); break;
+         case 'n': nodes = strtoul(optarg, nullptr, 0); break;
+         case 'w': workers = (unsigned) atoi(optarg); break;
+         case 'c': corrupt = (unsigned) atoi(optarg); break;
+         default:
+            fprintf(stderr, "usage: %s [-m megabytes] [-k streams] [-n nodes] [-w workers] [-c corrupt/1000]\n", argv[0]);
+            return option == 'h' ? 0 : 2;
+      }
+   }
+   if (workers == 0) {
+      workers = 1;
+   }
+   if (megabytes == 0 || streams == 0 || nodes < streams || nodes > 65535 || corrupt > 1000) {
+      fprintf(stderr, "invalid arguments\n");
+      return 2;
+   }
+   signal(SIGPIPE, SIG_IGN);
+
+   //the nodes are split among the streams (as the connections of the gateways)
+   std::vector<std::vector<uint8_t>> data(streams);
+   size_t perStream = megabytes * 1024 * 1024 / streams;
+   uint64_t total = 0;
+   for (size_t s = 0; s < streams; s++) {
+      std::vector<uint16_t> group;
+      for (size_t i = s; i < nodes; i += streams) {
+         group.push_back((uint16_t) (1 + i));
+      }
+      d7s::Fleet fleet(group, 1 + (uint32_t) s, corrupt);
+      fleet.fill(data[s], perStream);
+      total += data[s].size();
+   }
+   printf("data %.1f MB, %zu streams, %zu nodes, %u workers\n", total / 1e6, streams, nodes, workers);
+
+   //parser only
+   {
+      d7s::FrameScanner scanner;
+      uint64_t sum = 0;
+      Clock::time_point start = Clock::now();
+      for (const auto &stream : data) {
+         scanner.feed(stream.data(), stream.size(), [&sum](const d7s::FrameView &frame) { sum += frame.sequence(); });
+      }
+      result("scan", scanner.stats().frames, scanner.stats().bytes, seconds(start));
+      if (sum == 0) {
+         printf("no frames\n");
+      }
+   }
+
+   //parser and table (chunks of 64KiB as the reads of the daemon)
+   {
+      d7s::NodeTable table;
+      std::vector<std::thread> threads;
+      std::vector<uint64_t> frames(workers, 0);
+      Clock::time_point start = Clock::now();
+      for (unsigned w = 0; w < workers; w++) {
+         threads.emplace_back([&, w] {
+            for (size_t s = w; s < streams; s += workers) {
+               d7s::FrameScanner scanner;
+               const std::vector<uint8_t> &stream = data[s];
+               for (size_t at = 0; at < stream.size(); at += 64 * 1024) {
+                  size_t len = std::min<size_t>(64 * 1024, stream.size() - at);
+                  scanner.feed(stream.data() + at, len, [&table](const d7s::FrameView &frame) { table.update(frame); });
+               }
+               frames[w] += scanner.stats().frames;
+            }
+         });
+      }
+      uint64_t sum = 0;
+      for (unsigned w = 0; w < workers; w++) {
+         threads[w].join();
+         sum += frames[w];
+      }
+      result("table", sum, total, seconds(start));
+   }
+
+   //the daemon path (socket pairs read by the workers of Ingest)
+   {
+      d7s::NodeTable table;
+      d7s::Ingest ingest(table, workers);
+      std::vector<int> writers;
+      for (size_t s = 0; s < streams; s++) {
+         int pair[2];
+         if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, pair) != 0) {
+            perror("socketpair");
+            return 1;
+         }
+         ingest.addFd(pair[0]);
+         writers.push_back(pair[1]);
+      }
+      std::vector<std::thread> threads;
+      Clock::time_point start = Clock::now();
+      for (size_t s = 0; s < streams; s++) {
+         threads.emplace_back([&, s] {
+            const uint8_t *p = data[s].data();
+            size_t left = data[s].size();
+            while (left > 0) {
+               ssize_t written = write(writers[s], p, left);
+               if (written <= 0) {
+                  break;
+               }
+               p += written;
+               left -= (size_t) written;
+            }
+            close(writers[s]);
+         });
+      }
+      for (std::thread &thread : threads) {
+         thread.join();
+      }
+      ingest.wait();
+      double elapsed = seconds(start);
+      d7s::IngestStats stats = ingest.stats();
+      result("ingest", stats.frames, stats.bytes, elapsed);
+      printf("nodes %zu crc_errors %llu length_errors %llu\n", table.active(), (unsigned long long) stats.crcErrors,
+         (unsigned long long) stats.lengthErrors);
+   }
+   return 0;
+}
@@ -0,0 +1,204 @@
+/*
+   Copyright 2017 Alessandro Pasqualini
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+     http://www.apache.org/licenses/LICENSE-2.0
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+
+   @author    Alessandro Pasqualini <alessandro.pasqualini.1105@gmail.com>
+   @url       https://github.com/alessandro1105
+
+   This project has been developed with the contribution of Futura Elettronica.
+   - http://www.futurashop.it
+   - http://www.elettronicain.it
+   - https://www.open-electronics.org
+*/
+
+#ifndef D7S_HOST_FLEET_H
+#define D7S_HOST_FLEET_H
+
+#include <cstdint>
+#include <vector>
+
+#include "frame.h"
+
+namespace d7s {
+
+//stand-in of a fleet of nodes running the TelemetryFrames example (deterministic for a given seed)
+//each node sends STATUS frames while idle, then START_EARTHQUAKE, SAMPLE frames, END_EARTHQUAKE, EARTHQUAKE and
+//from time to time STATISTICS; the frames of the nodes are interleaved round robin
+class Fleet {
+
+   public:
+
+      //what the fleet sent to each node (to check the ingest)
+      struct Expected {
+         uint64_t frames = 0; //valid frames sent
+         uint64_t lost = 0; //frames dropped or corrupted between two valid ones (the gaps seen by the sequence numbers)
+         uint64_t missing = 0; //frames dropped or corrupted since the lastest valid one
+         uint64_t earthquakes = 0;
+         uint16_t maxSI = 0;
+         uint16_t maxPGA = 0;
+      };
+
+      //nodes: ids of the nodes; corrupt, drop: probability [1/1000] of corrupting or dropping a frame
+      Fleet(const std::vector<uint16_t> &nodes, uint32_t seed, unsigned corrupt = 0, unsigned drop = 0)
+         : _corrupt(corrupt), _drop(drop), _random(seed ? seed : 1) {
+         for (uint16_t id : nodes) {
+            Node node;
+            node.id = id;
+            node.millis = random() % 1000;
+            _nodes.push_back(node);
+         }
+      }
+
+      //nodes first..first+count-1
+      static std::vector<uint16_t> range(uint16_t first, size_t count) {
+         std::vector<uint16_t> nodes;
+         for (size_t i = 0; i < count; i++) {
+            nodes.push_back((uint16_t) (first + i));
+         }
+         return nodes;
+      }
+
+      //write the next frame into out (D7S_FRAME_MAX_SIZE bytes) and return its size (0 if it has been dropped)
+      size_t next(uint8_t *out) {
+         Node &node = _nodes[_current];
+         _current = (_current + 1) % _nodes.size();
+         Expected &expected = _expected[node.id];
+
+         size_t size = step(node, out);
+         unsigned roll = random() % 1000;
+         if (roll < _drop) {
+            expected.missing++;
+            return 0;
+         }
+         if (roll < _drop + _corrupt) {
+            //a single flipped byte after the sync byte (always caught by the CRC-8)
+            size_t at = 1 + random() % (size - 1);
+            out[at] ^= 1 + random() % 255;
+            expected.missing++;
+            return size;
+         }
+         //the frames missing before the first one cannot be seen by the sequence numbers
+         if (expected.frames++) {
+            expected.lost += expected.missing;
+         }
+         expected.missing = 0;
+         if (out[1] == FRAME_EARTHQUAKE) {
+            expected.earthquakes++;
+         }
+         //offsets of SI and PGA in the payload
+         size_t si = out[1] == FRAME_SAMPLE ? 4 : 2;
+         size_t pga = out[1] == FRAME_EARTHQUAKE ? 4 : 6;
+         if (out[1] == FRAME_EARTHQUAKE || out[1] == FRAME_SAMPLE || out[1] == FRAME_STATISTICS) {
+            uint16_t value = be16(out + FRAME_HEADER_SIZE + si);
+            expected.maxSI = value > expected.maxSI ? value : expected.maxSI;
+            value = be16(out + FRAME_HEADER_SIZE + pga);
+            expected.maxPGA = value > expected.maxPGA ? value : expected.maxPGA;
+         }
+         return size;
+      }
+
+      //append frames to the buffer until it holds at least bytes bytes
+      void fill(std::vector<uint8_t> &buffer, size_t bytes) {
+         uint8_t frame[FRAME_MAX_SIZE];
+         while (buffer.size() < bytes) {
+            size_t size = next(frame);
+            buffer.insert(buffer.end(), frame, frame + size);
+         }
+      }
+
+      const Expected &expected(uint16_t node) const {
+         return _expected[node];
+      }
+
+      size_t nodes() const {
+         return _nodes.size();
+      }
+
+   private:
+
+      enum Phase { IDLE, SHAKING, ENDED, RECORDED };
+
+      struct Node {
+         uint16_t id = 0;
+         uint8_t sequence = 0;
+         Phase phase = IDLE;
+         uint32_t millis = 0;
+         unsigned samples = 0; //SAMPLE frames left of the current earthquake
+         uint16_t si = 0; //peak of the current earthquake
+         uint16_t pga = 0;
+         uint16_t count = 0; //statistics of the window
+         uint16_t maxSI = 0;
+         uint16_t maxPGA = 0;
+         uint32_t sumSI = 0;
+      };
+
+      size_t step(Node &node, uint8_t *out) {
+         uint8_t sequence = node.sequence++;
+         node.millis += 100;
+         switch (node.phase) {
+            case IDLE:
+               if (random() % 8 == 0) {
+                  node.phase = SHAKING;
+                  node.samples = 2 + random() % 10;
+                  node.si = 0;
+                  node.pga = 0;
+                  return encode(out, node.id, sequence, EventPayload{START_EARTHQUAKE, 0, 1});
+               }
+               return encode(out, node.id, sequence, StatusPayload{0, 2, 0, 0});
+            case SHAKING: {
+               uint16_t si = random() % 1500;
+               uint16_t pga = random() % 4000;
+               node.si = si > node.si ? si : node.si;
+               node.pga = pga > node.pga ? pga : node.pga;
+               if (--node.samples == 0) {
+                  node.phase = ENDED;
+               }
+               return encode(out, node.id, sequence, SamplePayload{node.millis, si, pga});
+            }
+            case ENDED:
+               node.phase = RECORDED;
+               return encode(out, node.id, sequence, EventPayload{END_EARTHQUAKE, 0, 0});
+            default: {
+               node.phase = IDLE;
+               node.count++;
+               node.sumSI += node.si;
+               node.maxSI = node.si > node.maxSI ? node.si : node.maxSI;
+               node.maxPGA = node.pga > node.maxPGA ? node.pga : node.maxPGA;
+               int16_t temperature = (int16_t) (random() % 600) - 100;
+               //the window statistics replace the record from time to time (as the hourly frame of the example)
+               if (node.count % 4 == 0) {
+                  uint16_t mean = (uint16_t) (node.sumSI / node.count);
+                  return encode(out, node.id, sequence, StatisticsPayload{node.count, node.maxSI, mean, node.maxPGA, 3});
+               }
+               return encode(out, node.id, sequence, EarthquakePayload{temperature, node.si, node.pga});
+            }
+         }
+      }
+
+      //xorshift32
+      uint32_t random() {
+         _random ^= _random << 13;
+         _random ^= _random >> 17;
+         _random ^= _random << 5;
+         return _random;
+      }
+
+      std::vector<Node> _nodes;
+      std::vector<Expected> _expected = std::vector<Expected>(65536);
+      size_t _current = 0;
+      unsigned _corrupt;
+      unsigned _drop;
+      uint32_t _random;
+};
+
+}
+
+#endif
@@ -0,0 +1,304 @@
+/*
+   Copyright 2017 Alessandro Pasqualini
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+     http://www.apache.org/licenses/LICENSE-2.0
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+
+   @author    Alessandro Pasqualini <alessandro.pasqualini.1105@gmail.com>
+   @url       https://github.com/alessandro1105
+
+   This project has been developed with the contribution of Futura Elettronica.
+   - http://www.futurashop.it
+   - http://www.elettronicain.it
+   - https://www.open-electronics.org
+*/
+
+#ifndef D7S_HOST_FRAME_H
+#define D7S_HOST_FRAME_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+//host side of the telemetry frames encoded by D7SClass::encode*Frame() (see src/D7S.h)
+//frame: sync (0xD7), type, node id (2 bytes), sequence, payload length, payload, CRC-8
+//the CRC-8 (polynomial 0x07, init 0x00) covers everything but the sync byte, all the values are big endian
+namespace d7s {
+
+//--- TELEMETRY FRAMES ---
+constexpr uint8_t FRAME_SYNC = 0xD7; //first byte of each frame
+constexpr size_t FRAME_HEADER_SIZE = 6; //sync, type, node id (2 bytes), sequence, payload length
+constexpr size_t FRAME_MAX_SIZE = 16; //max size of a frame (header, payload and CRC-8)
+constexpr size_t FRAME_MAX_PAYLOAD = FRAME_MAX_SIZE - FRAME_HEADER_SIZE - 1;
+
+//frame types
+constexpr uint8_t FRAME_STATUS = 0x01; //state, axis in use, event bits, bus status (4 bytes)
+constexpr uint8_t FRAME_EARTHQUAKE = 0x02; //temperature [0.1 Celsius], SI [mm/s], PGA [mm/s^2] (6 bytes)
+constexpr uint8_t FRAME_SAMPLE = 0x03; //millis() [ms], instantaneus SI [mm/s], instantaneus PGA [mm/s^2] (8 bytes)
+constexpr uint8_t FRAME_STATISTICS = 0x04; //count, max SI [mm/s], mean SI [mm/s], max PGA [mm/s^2], max JMA intensity (9 bytes)
+constexpr uint8_t FRAME_EVENT = 0x05; //interrupt event, event bits, tracked state (3 bytes)
+
+//interrupt events (d7s_interrupt_event)
+constexpr uint8_t START_EARTHQUAKE = 0;
+constexpr uint8_t END_EARTHQUAKE = 1;
+constexpr uint8_t SHUTOFF_EVENT = 2;
+constexpr uint8_t COLLAPSE_EVENT = 3;
+
+//payload length of a known type (0 if the type is unknown)
+constexpr uint8_t payloadLength(uint8_t type) {
+   return type == FRAME_STATUS ? 4 :
+          type == FRAME_EARTHQUAKE ? 6 :
+          type == FRAME_SAMPLE ? 8 :
+          type == FRAME_STATISTICS ? 9 :
+          type == FRAME_EVENT ? 3 : 0;
+}
+
+//CRC-8 (polynomial 0x07, init 0x00) as computed by the D7S library, a bit at a time
+inline uint8_t crc8Bitwise(const uint8_t *data, size_t len, uint8_t crc = 0) {
+   for (size_t i = 0; i < len; i++) {
+      crc ^= data[i];
+      for (uint8_t bit = 0; bit < 8; bit++) {
+         crc = (crc & 0x80) ? (crc << 1) ^ 0x07 : crc << 1;
+      }
+   }
+   return crc;
+}
+
+//CRC-8 of each byte (the host has the memory for a table the device does not)
+struct Crc8Table {
+   uint8_t value[256];
+   constexpr Crc8Table() : value() {
+      for (int i = 0; i < 256; i++) {
+         uint8_t crc = (uint8_t) i;
+         for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x80) ? (uint8_t) ((crc << 1) ^ 0x07) : (uint8_t) (crc << 1);
+         }
+         value[i] = crc;
+      }
+   }
+};
+
+inline constexpr Crc8Table CRC8_TABLE;
+
+//same CRC-8 a byte at a time
+inline uint8_t crc8(const uint8_t *data, size_t len, uint8_t crc = 0) {
+   for (size_t i = 0; i < len; i++) {
+      crc = CRC8_TABLE.value[crc ^ data[i]];
+   }
+   return crc;
+}
+
+inline uint16_t be16(const uint8_t *p) {
+   return (uint16_t) ((p[0] << 8) | p[1]);
+}
+
+inline uint32_t be32(const uint8_t *p) {
+   return ((uint32_t) p[0] << 24) | ((uint32_t) p[1] << 16) | ((uint32_t) p[2] << 8) | p[3];
+}
+
+//a validated frame inside a buffer owned by someone else (no copy, valid as long as the buffer)
+class FrameView {
+
+   public:
+
+      FrameView() : _data(nullptr) {}
+      explicit FrameView(const uint8_t *data) : _data(data) {}
+
+      const uint8_t *data() const { return _data; }
+      uint8_t type() const { return _data[1]; }
+      uint16_t node() const { return be16(_data + 2); }
+      uint8_t sequence() const { return _data[4]; }
+      uint8_t length() const { return _data[5]; }
+      const uint8_t *payload() const { return _data + FRAME_HEADER_SIZE; }
+      size_t size() const { return FRAME_HEADER_SIZE + _data[5] + 1; }
+
+   private:
+
+      const uint8_t *_data;
+};
+
+//result of parseFrame()
+enum class ParseResult {
+   OK = 0,
+   NEED_MORE = 1, //the frame is truncated (a longer buffer may hold it)
+   BAD_SYNC = 2, //the first byte is not the sync byte
+   BAD_LENGTH = 3, //the payload length does not match the type or the max size
+   BAD_CRC = 4 //the CRC-8 does not match
+};
+
+//validate the frame at the beginning of the buffer (the view points into the buffer)
+//unknown types are accepted if they fit into a frame, known types must have their payload length
+inline ParseResult parseFrame(const uint8_t *data, size_t len, FrameView &frame) {
+   if (len == 0) {
+      return ParseResult::NEED_MORE;
+   }
+   if (data[0] != FRAME_SYNC) {
+      return ParseResult::BAD_SYNC;
+   }
+   if (len < FRAME_HEADER_SIZE) {
+      return ParseResult::NEED_MORE;
+   }
+   uint8_t expected = payloadLength(data[1]);
+   if (data[5] > FRAME_MAX_PAYLOAD || (expected != 0 && data[5] != expected)) {
+      return ParseResult::BAD_LENGTH;
+   }
+   size_t size = FRAME_HEADER_SIZE + data[5] + 1;
+   if (len < size) {
+      return ParseResult::NEED_MORE;
+   }
+   if (crc8(data + 1, size - 2) != data[size - 1]) {
+      return ParseResult::BAD_CRC;
+   }
+   frame = FrameView(data);
+   return ParseResult::OK;
+}
+
+//--- PAYLOADS ---
+struct StatusPayload {
+   uint8_t state; //d7s_status
+   uint8_t axis; //d7s_axis_state
+   uint8_t events; //event bits (first bit => SHUTOFF, second bit => COLLAPSE)
+   uint8_t bus; //d7s_bus_status of the read
+};
+
+struct EarthquakePayload {
+   int16_t temperature; //[0.1 Celsius]
+   uint16_t si; //[mm/s]
+   uint16_t pga; //[mm/s^2]
+};
+
+struct SamplePayload {
+   uint32_t millis; //[ms]
+   uint16_t si; //[mm/s]
+   uint16_t pga; //[mm/s^2]
+};
+
+struct StatisticsPayload {
+   uint16_t count;
+   uint16_t maxSI; //[mm/s]
+   uint16_t meanSI; //[mm/s]
+   uint16_t maxPGA; //[mm/s^2]
+   uint8_t maxIntensity; //d7s_jma_intensity
+};
+
+struct EventPayload {
+   uint8_t event; //d7s_interrupt_event
+   uint8_t events; //event bits
+   uint8_t state; //d7s_status
+};
+
+//decode the payload (false if the frame has another type)
+inline bool decode(const FrameView &frame, StatusPayload &out) {
+   if (frame.type() != FRAME_STATUS) {
+      return false;
+   }
+   const uint8_t *p = frame.payload();
+   out = {p[0], p[1], p[2], p[3]};
+   return true;
+}
+
+inline bool decode(const FrameView &frame, EarthquakePayload &out) {
+   if (frame.type() != FRAME_EARTHQUAKE) {
+      return false;
+   }
+   const uint8_t *p = frame.payload();
+   out = {(int16_t) be16(p), be16(p + 2), be16(p + 4)};
+   return true;
+}
+
+inline bool decode(const FrameView &frame, SamplePayload &out) {
+   if (frame.type() != FRAME_SAMPLE) {
+      return false;
+   }
+   const uint8_t *p = frame.payload();
+   out = {be32(p), be16(p + 4), be16(p + 6)};
+   return true;
+}
+
+inline bool decode(const FrameView &frame, StatisticsPayload &out) {
+   if (frame.type() != FRAME_STATISTICS) {
+      return false;
+   }
+   const uint8_t *p = frame.payload();
+   out = {be16(p), be16(p + 2), be16(p + 4), be16(p + 6), p[8]};
+   return true;
+}
+
+inline bool decode(const FrameView &frame, EventPayload &out) {
+   if (frame.type() != FRAME_EVENT) {
+      return false;
+   }
+   const uint8_t *p = frame.payload();
+   out = {p[0], p[1], p[2]};
+   return true;
+}
+
+//--- ENCODER ---
+//same encoding of the library (used by the simulator and the tests)
+inline size_t encodeFrame(uint8_t *frame, uint8_t type, uint16_t node, uint8_t sequence, const uint8_t *payload, uint8_t len) {
+   if (FRAME_HEADER_SIZE + len + 1 > FRAME_MAX_SIZE) {
+      return 0;
+   }
+   frame[0] = FRAME_SYNC;
+   frame[1] = type;
+   frame[2] = node >> 8;
+   frame[3] = node & 0xFF;
+   frame[4] = sequence;
+   frame[5] = len;
+   memcpy(frame + FRAME_HEADER_SIZE, payload, len);
+   size_t size = FRAME_HEADER_SIZE + len;
+   frame[size] = crc8(frame + 1, size - 1);
+   return size + 1;
+}
+
+inline uint8_t *putBE16(uint8_t *p, uint16_t value) {
+   p[0] = value >> 8;
+   p[1] = value & 0xFF;
+   return p + 2;
+}
+
+inline uint8_t *putBE32(uint8_t *p, uint32_t value) {
+   p[0] = value >> 24;
+   p[1] = (value >> 16) & 0xFF;
+   p[2] = (value >> 8) & 0xFF;
+   p[3] = value & 0xFF;
+   return p + 4;
+}
+
+inline size_t encode(uint8_t *frame, uint16_t node, uint8_t sequence, const StatusPayload &in) {
+   uint8_t p[4] = {in.state, in.axis, in.events, in.bus};
+   return encodeFrame(frame, FRAME_STATUS, node, sequence, p, sizeof(p));
+}
+
+inline size_t encode(uint8_t *frame, uint16_t node, uint8_t sequence, const EarthquakePayload &in) {
+   uint8_t p[6];
+   putBE16(putBE16(putBE16(p, (uint16_t) in.temperature), in.si), in.pga);
+   return encodeFrame(frame, FRAME_EARTHQUAKE, node, sequence, p, sizeof(p));
+}
+
+inline size_t encode(uint8_t *frame, uint16_t node, uint8_t sequence, const SamplePayload &in) {
+   uint8_t p[8];
+   putBE16(putBE16(putBE32(p, in.millis), in.si), in.pga);
+   return encodeFrame(frame, FRAME_SAMPLE, node, sequence, p, sizeof(p));
+}
+
+inline size_t encode(uint8_t *frame, uint16_t node, uint8_t sequence, const StatisticsPayload &in) {
+   uint8_t p[9];
+   putBE16(putBE16(putBE16(putBE16(p, in.count), in.maxSI), in.meanSI), in.maxPGA)[0] = in.maxIntensity;
+   return encodeFrame(frame, FRAME_STATISTICS, node, sequence, p, sizeof(p));
+}
+
+inline size_t encode(uint8_t *frame, uint16_t node, uint8_t sequence, const EventPayload &in) {
+   uint8_t p[3] = {in.event, in.events, in.state};
+   return encodeFrame(frame, FRAME_EVENT, node, sequence, p, sizeof(p));
+}
+
+}
+
+#endif
@@ -0,0 +1,105 @@
+/*
+   Copyright 2017 Alessandro Pasqualini
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+     http://www.apache.org/licenses/LICENSE-2.0
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+
+   @author    Alessandro Pasqualini <alessandro.pasqualini.1105@gmail.com>
+   @url       https://github.com/alessandro1105
+
+   This project has been developed with the contribution of Futura Elettronica.
+   - http://www.futurashop.it
+   - http://www.elettronicain.it
+   - https://www.open-electronics.org
+*/
+
+#ifndef D7S_HOST_INGEST_H
+#define D7S_HOST_INGEST_H
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "node_table.h"
+#include "scanner.h"
+
+namespace d7s {
+
+//totals of all the sources
+struct IngestStats {
+   uint64_t frames = 0;
+   uint64_t bytes = 0;
+   uint64_t crcErrors = 0;
+   uint64_t lengthErrors = 0;
+   uint64_t skipped = 0;
+   uint64_t sources = 0; //sources ended
+};
+
+//ingest the frames of many streams into a NodeTable with a pool of workers
+//each worker waits on its own epoll set: pipes and sockets are read as the data arrives (each one with its own scanner),
+//regular files are mapped and scanned in place; a stream is always read by the same worker (the frames of a node stay in order)
+class Ingest {
+
+   public:
+
+      Ingest(NodeTable &table, unsigned workers);
+      ~Ingest();
+
+      Ingest(const Ingest &) = delete;
+      Ingest &operator=(const Ingest &) = delete;
+
+      //add a file, a named pipe or "-" (stdin), return false on error (error is set)
+      bool addFile(const std::string &path, std::string &error);
+      //add a pipe or a connected socket (the descriptor is owned and closed by the ingest, at once after stop())
+      void addFd(int fd);
+      //ingest the connections to a local (unix) socket until stop(), return false on error (error is set)
+      bool listen(const std::string &path, std::string &error);
+
+      //number of sources not ended yet (the listening socket excluded)
+      size_t open() const;
+      //wait until all the sources are ended (up to timeoutMs if not 0), return true if they are
+      bool wait(unsigned timeoutMs = 0);
+      //stop the workers and the listener and close all the sources
+      void stop();
+
+      IngestStats stats() const;
+
+   private:
+
+      struct Worker;
+
+      void addFile(int fd, size_t size);
+      void accept();
+      void ended();
+      Worker &next();
+
+      NodeTable &_table;
+      std::vector<std::unique_ptr<Worker>> _workers;
+      std::atomic<unsigned> _next{0};
+      std::atomic<size_t> _open{0};
+      std::atomic<uint64_t> _ended{0};
+      IngestStats _final; //counters of the workers stopped
+      mutable std::mutex _mutex;
+      std::condition_variable _idle;
+
+      //listener
+      std::thread _listener;
+      int _listenFd = -1;
+      int _listenWake = -1;
+      std::string _listenPath;
+      bool _stopped = false;
+};
+
+}
+
+#endif
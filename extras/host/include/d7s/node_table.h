@@ -0,0 +1,189 @@
+/*
+   Copyright 2017 Alessandro Pasqualini
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+     http://www.apache.org/licenses/LICENSE-2.0
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+
+   @author    Alessandro Pasqualini <alessandro.pasqualini.1105@gmail.com>
+   @url       https://github.com/alessandro1105
+
+   This project has been developed with the contribution of Futura Elettronica.
+   - http://www.futurashop.it
+   - http://www.elettronicain.it
+   - https://www.open-electronics.org
+*/
+
+#ifndef D7S_HOST_NODE_TABLE_H
+#define D7S_HOST_NODE_TABLE_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+#include "frame.h"
+
+namespace d7s {
+
+//copy of the state of a node
+struct NodeSnapshot {
+   uint16_t node = 0;
+   uint64_t frames = 0; //frames received
+   uint64_t lost = 0; //frames missing according to the sequence numbers
+   uint64_t earthquakes = 0; //EARTHQUAKE frames received
+   uint64_t events[4] = {0, 0, 0, 0}; //EVENT frames received (by d7s_interrupt_event)
+   uint8_t state = 0; //lastest d7s_status (STATUS or EVENT frames)
+   uint8_t eventBits = 0; //lastest event bits (STATUS or EVENT frames)
+   uint8_t bus = 0; //lastest d7s_bus_status (STATUS frames)
+   int16_t temperature = 0; //lastest temperature [0.1 Celsius]
+   uint16_t lastSI = 0; //lastest SI (EARTHQUAKE or SAMPLE frames) [mm/s]
+   uint16_t lastPGA = 0; //lastest PGA (EARTHQUAKE or SAMPLE frames) [mm/s^2]
+   uint16_t maxSI = 0; //max SI received [mm/s]
+   uint16_t maxPGA = 0; //max PGA received [mm/s^2]
+   uint8_t maxIntensity = 0; //max JMA intensity of the STATISTICS frames
+};
+
+//state of all the nodes of the fleet, indexed by node id (the node id is 16 bit, so there is no lookup)
+//update() is lock-free and can be called by all the workers at once: each field is an atomic on its own, so a snapshot
+//may mix two frames of the same node; the loss count assumes the frames of a node are fed in order (one stream per node)
+class NodeTable {
+
+   public:
+
+      static constexpr size_t NODES = 65536;
+
+      NodeTable() : _nodes(new Node[NODES]) {}
+
+      //account a valid frame
+      void update(const FrameView &frame) {
+         Node &n = _nodes[frame.node()];
+         if (n.frames.fetch_add(1, std::memory_order_relaxed) == 0) {
+            _active.fetch_add(1, std::memory_order_relaxed);
+         }
+
+         //sequence gap (the previous sequence is stored with bit 8 set once a frame has been received)
+         uint16_t previous = n.sequence.exchange(0x100 | frame.sequence(), std::memory_order_relaxed);
+         if (previous & 0x100) {
+            uint8_t gap = (uint8_t) (frame.sequence() - (uint8_t) previous - 1);
+            if (gap) {
+               n.lost.fetch_add(gap, std::memory_order_relaxed);
+            }
+         }
+
+         const uint8_t *p = frame.payload();
+         switch (frame.type()) {
+            case FRAME_STATUS:
+               n.state.store(p[0], std::memory_order_relaxed);
+               n.eventBits.store(p[2], std::memory_order_relaxed);
+               n.bus.store(p[3], std::memory_order_relaxed);
+               break;
+            case FRAME_EARTHQUAKE:
+               n.earthquakes.fetch_add(1, std::memory_order_relaxed);
+               n.temperature.store((int16_t) be16(p), std::memory_order_relaxed);
+               measure(n, be16(p + 2), be16(p + 4));
+               break;
+            case FRAME_SAMPLE:
+               measure(n, be16(p + 4), be16(p + 6));
+               break;
+            case FRAME_STATISTICS:
+               max(n.maxSI, be16(p + 2));
+               max(n.maxPGA, be16(p + 6));
+               max(n.maxIntensity, p[8]);
+               break;
+            case FRAME_EVENT:
+               if (p[0] < 4) {
+                  n.events[p[0]].fetch_add(1, std::memory_order_relaxed);
+               }
+               n.eventBits.store(p[1], std::memory_order_relaxed);
+               n.state.store(p[2], std::memory_order_relaxed);
+               break;
+         }
+      }
+
+      //number of nodes that sent at least a frame
+      size_t active() const {
+         return _active.load(std::memory_order_relaxed);
+      }
+
+      //copy the state of a node (false if it never sent a frame)
+      bool snapshot(uint16_t node, NodeSnapshot &out) const {
+         const Node &n = _nodes[node];
+         out.node = node;
+         out.frames = n.frames.load(std::memory_order_relaxed);
+         if (out.frames == 0) {
+            return false;
+         }
+         out.lost = n.lost.load(std::memory_order_relaxed);
+         out.earthquakes = n.earthquakes.load(std::memory_order_relaxed);
+         for (int i = 0; i < 4; i++) {
+            out.events[i] = n.events[i].load(std::memory_order_relaxed);
+         }
+         out.state = n.state.load(std::memory_order_relaxed);
+         out.eventBits = n.eventBits.load(std::memory_order_relaxed);
+         out.bus = n.bus.load(std::memory_order_relaxed);
+         out.temperature = n.temperature.load(std::memory_order_relaxed);
+         out.lastSI = n.lastSI.load(std::memory_order_relaxed);
+         out.lastPGA = n.lastPGA.load(std::memory_order_relaxed);
+         out.maxSI = n.maxSI.load(std::memory_order_relaxed);
+         out.maxPGA = n.maxPGA.load(std::memory_order_relaxed);
+         out.maxIntensity = n.maxIntensity.load(std::memory_order_relaxed);
+         return true;
+      }
+
+      //call f(const NodeSnapshot &) for each node that sent at least a frame
+      template <class F>
+      void forEach(F &&f) const {
+         NodeSnapshot snap;
+         for (size_t node = 0; node < NODES; node++) {
+            if (snapshot((uint16_t) node, snap)) {
+               f(snap);
+            }
+         }
+      }
+
+   private:
+
+      //a cache line for each node (the workers update different nodes without false sharing)
+      struct alignas(64) Node {
+         std::atomic<uint64_t> frames{0};
+         std::atomic<uint64_t> lost{0};
+         std::atomic<uint64_t> earthquakes{0};
+         std::atomic<uint32_t> events[4] = {{0}, {0}, {0}, {0}};
+         std::atomic<uint16_t> sequence{0};
+         std::atomic<int16_t> temperature{0};
+         std::atomic<uint16_t> lastSI{0};
+         std::atomic<uint16_t> lastPGA{0};
+         std::atomic<uint16_t> maxSI{0};
+         std::atomic<uint16_t> maxPGA{0};
+         std::atomic<uint8_t> state{0};
+         std::atomic<uint8_t> eventBits{0};
+         std::atomic<uint8_t> bus{0};
+         std::atomic<uint8_t> maxIntensity{0};
+      };
+
+      template <class T>
+      static void max(std::atomic<T> &field, T value) {
+         T current = field.load(std::memory_order_relaxed);
+         while (current < value && !field.compare_exchange_weak(current, value, std::memory_order_relaxed))
+            ;
+      }
+
+      static void measure(Node &n, uint16_t si, uint16_t pga) {
+         n.lastSI.store(si, std::memory_order_relaxed);
+         n.lastPGA.store(pga, std::memory_order_relaxed);
+         max(n.maxSI, si);
+         max(n.maxPGA, pga);
+      }
+
+      std::unique_ptr<Node[]> _nodes;
+      std::atomic<size_t> _active{0};
+};
+
+}
+
+#endif
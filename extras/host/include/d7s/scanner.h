@@ -0,0 +1,143 @@
+/*
+   Copyright 2017 Alessandro Pasqualini
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+     http://www.apache.org/licenses/LICENSE-2.0
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+
+   @author    Alessandro Pasqualini <alessandro.pasqualini.1105@gmail.com>
+   @url       https://github.com/alessandro1105
+
+   This project has been developed with the contribution of Futura Elettronica.
+   - http://www.futurashop.it
+   - http://www.elettronicain.it
+   - https://www.open-electronics.org
+*/
+
+#ifndef D7S_HOST_SCANNER_H
+#define D7S_HOST_SCANNER_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#include "frame.h"
+
+namespace d7s {
+
+//counters of a scanner
+struct ScanStats {
+   uint64_t frames = 0; //valid frames found
+   uint64_t bytes = 0; //bytes fed
+   uint64_t crcErrors = 0; //frames dropped by the CRC-8
+   uint64_t lengthErrors = 0; //frames dropped by the payload length
+   uint64_t skipped = 0; //bytes skipped to find the next sync byte (corrupted frames included)
+};
+
+//find the frames of a byte stream (file, pipe, socket) fed in chunks of any size
+//the frames inside a chunk are passed in place (FrameView into the chunk), only a frame split across two chunks is
+//assembled into a buffer of D7S_FRAME_MAX_SIZE bytes; after a corrupted frame the scanner resyncs at the next sync byte
+class FrameScanner {
+
+   public:
+
+      //feed the next chunk, onFrame(const FrameView &) is called for each valid frame (the view is valid during the call only)
+      template <class F>
+      void feed(const uint8_t *data, size_t len, F &&onFrame) {
+         _stats.bytes += len;
+         size_t consumed = 0;
+
+         //complete the frame split across the chunks
+         while (_carryLen > 0 && consumed < len) {
+            size_t take = std::min(FRAME_MAX_SIZE - _carryLen, len - consumed);
+            memcpy(_carry + _carryLen, data + consumed, take);
+            size_t total = _carryLen + take;
+            size_t pos = scan(_carry, total, onFrame);
+            if (pos >= _carryLen) {
+               //the scan went past the old bytes, go on in place
+               consumed += pos - _carryLen;
+               _carryLen = 0;
+               break;
+            }
+            //the remaining bytes are still the beginning of a frame
+            memmove(_carry, _carry + pos, total - pos);
+            _carryLen = total - pos;
+            consumed += take;
+         }
+
+         //scan in place
+         if (_carryLen == 0 && consumed < len) {
+            size_t pos = consumed + scan(data + consumed, len - consumed, onFrame);
+            _carryLen = len - pos;
+            memcpy(_carry, data + pos, _carryLen);
+         }
+      }
+
+      //end of the stream: the bytes of a truncated frame are skipped
+      void finish() {
+         _stats.skipped += _carryLen;
+         _carryLen = 0;
+      }
+
+      //bytes of a truncated frame waiting for the next chunk
+      size_t pending() const {
+         return _carryLen;
+      }
+
+      const ScanStats &stats() const {
+         return _stats;
+      }
+
+   private:
+
+      //scan the buffer and return where the truncated frame at its end begins (len if there is none)
+      template <class F>
+      size_t scan(const uint8_t *data, size_t len, F &onFrame) {
+         size_t pos = 0;
+         while (pos < len) {
+            //resync at the next sync byte
+            if (data[pos] != FRAME_SYNC) {
+               const void *sync = memchr(data + pos, FRAME_SYNC, len - pos);
+               size_t next = sync ? (const uint8_t *) sync - data : len;
+               _stats.skipped += next - pos;
+               pos = next;
+               continue;
+            }
+            FrameView frame;
+            switch (parseFrame(data + pos, len - pos, frame)) {
+               case ParseResult::OK:
+                  _stats.frames++;
+                  onFrame(frame);
+                  pos += frame.size();
+                  break;
+               case ParseResult::NEED_MORE:
+                  return pos;
+               case ParseResult::BAD_CRC:
+                  //the sync byte may be part of a corrupted frame, look for the next one
+                  _stats.crcErrors++;
+                  _stats.skipped++;
+                  pos++;
+                  break;
+               default:
+                  _stats.lengthErrors++;
+                  _stats.skipped++;
+                  pos++;
+                  break;
+            }
+         }
+         return len;
+      }
+
+      uint8_t _carry[FRAME_MAX_SIZE];
+      size_t _carryLen = 0;
+      ScanStats _stats;
+};
+
+}
+
+#endif
@@ -0,0 +1,128 @@
+/*
+   Copyright 2017 Alessandro Pasqualini
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+     http://www.apache.org/licenses/LICENSE-2.0
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+
+   @author    Alessandro Pasqualini <alessandro.pasqualini.1105@gmail.com>
+   @url       https://github.com/alessandro1105
+
+   This project has been developed with the contribution of Futura Elettronica.
+   - http://www.futurashop.it
+   - http://www.elettronicain.it
+   - https://www.open-electronics.org
+*/
+
+//ingest daemon: read the telemetry frames of the fleet from files, pipes, serial ports, stdin and a local socket,
+//keep the state of each node and print it at the end (all the inputs ended, SIGINT or SIGTERM) and every -r seconds
+
+#include <cinttypes>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <string>
+#include <thread>
+
+#include <getopt.h>
+
+#include "d7s/ingest.h"
+
+static void usage(const char *name) {
+   fprintf(stderr,
+      "usage: %s [-w workers] [-l socket] [-r seconds] [-q] [input...]\n"
+      "  input       file, named pipe, serial port or - (stdin)\n"
+      "  -w workers  worker threads (default: one for each CPU)\n"
+      "  -l socket   ingest the connections to this local socket until SIGINT/SIGTERM\n"
+      "  -r seconds  print the summary periodically\n"
+      "  -q          print the totals only (not each node)\n", name);
+}
+
+static void report(const d7s::Ingest &ingest, const d7s::NodeTable &table, bool nodes) {
+   d7s::IngestStats stats = ingest.stats();
+   uint64_t lost = 0;
+   table.forEach([&](const d7s::NodeSnapshot &node) {
+      lost += node.lost;
+      if (nodes) {
+         printf("node %u frames %" PRIu64 " lost %" PRIu64 " earthquakes %" PRIu64 " state %u events 0x%02X bus %u "
+            "si %u pga %u max_si %u max_pga %u max_jma %u temperature %.1f\n",
+            node.node, node.frames, node.lost, node.earthquakes, node.state, node.eventBits, node.bus,
+            node.lastSI, node.lastPGA, node.maxSI, node.maxPGA, node.maxIntensity, node.temperature / 10.0);
+      }
+   });
+   printf("total nodes %zu frames %" PRIu64 " bytes %" PRIu64 " lost %" PRIu64 " crc_errors %" PRIu64
+      " length_errors %" PRIu64 " skipped %" PRIu64 " sources %" PRIu64 "\n",
+      table.active(), stats.frames, stats.bytes, lost, stats.crcErrors, stats.lengthErrors, stats.skipped, stats.sources);
+   fflush(stdout);
+}
+
+int main(int argc, char **argv) {
+   unsigned workers = std::thread::hardware_concurrency();
+   std::string socket;
+   unsigned interval = 0;
+   bool quiet = false;
+
+   int option;
+   while ((option = getopt(argc, argv, "w:l:r:qh")) != -1) {
+      switch (option) {
+         case 'w': workers = (unsigned) atoi(optarg); break;
+         case 'l': socket = optarg; break;
+         case 'r': interval = (unsigned) atoi(optarg); break;
+         case 'q': quiet = true; break;
+         default: usage(argv[0]); return option == 'h' ? 0 : 2;
+      }
+   }
+   if (optind == argc && socket.empty()) {
+      usage(argv[0]);
+      return 2;
+   }
+
+   //the signals are handled by the main thread only (blocked before starting the workers)
+   sigset_t signals;
+   sigemptyset(&signals);
+   sigaddset(&signals, SIGINT);
+   sigaddset(&signals, SIGTERM);
+   pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+   signal(SIGPIPE, SIG_IGN);
+
+   d7s::NodeTable table;
+   d7s::Ingest ingest(table, workers);
+   std::string error;
+   if (!socket.empty() && !ingest.listen(socket, error)) {
+      fprintf(stderr, "%s\n", error.c_str());
+      return 1;
+   }
+   int status = 0;
+   for (int i = optind; i < argc; i++) {
+      if (!ingest.addFile(argv[i], error)) {
+         fprintf(stderr, "%s\n", error.c_str());
+         status = 1;
+      }
+   }
+
+   //run until all the inputs are ended (or forever with a socket) or a signal
+   time_t last = time(nullptr);
+   for (;;) {
+      if (socket.empty() && ingest.open() == 0) {
+         break;
+      }
+      timespec timeout = {0, 200 * 1000 * 1000};
+      if (sigtimedwait(&signals, nullptr, &timeout) > 0) {
+         break;
+      }
+      if (interval && time(nullptr) - last >= (time_t) interval) {
+         last = time(nullptr);
+         report(ingest, table, !quiet);
+      }
+   }
+
+   ingest.stop();
+   report(ingest, table, !quiet);
+   return status;
+}
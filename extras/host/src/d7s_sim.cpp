@@ -0,0 +1,180 @@
+/*
+   Copyright 2017 Alessandro Pasqualini
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+     http://www.apache.org/licenses/LICENSE-2.0
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+
+   @author    Alessandro Pasqualini <alessandro.pasqualini.1105@gmail.com>
+   @url       https://github.com/alessandro1105
+
+   This project has been developed with the contribution of Futura Elettronica.
+   - http://www.futurashop.it
+   - http://www.elettronicain.it
+   - https://www.open-electronics.org
+*/
+
+//fleet simulator: write the frames of a fleet of nodes to stdout, a file or a local socket (one connection for each
+//group of nodes, as the gateways of the fleet) to feed d7s_ingest without the hardware
+
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <getopt.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "d7s/fleet.h"
+
+static void usage(const char *name) {
+   fprintf(stderr,
+      "usage: %s [-n nodes] [-b first] [-f frames] [-s seed] [-c corrupt] [-d drop] [-k connections] [-u socket | -o file]\n"
+      "  -n nodes        nodes of the fleet (default 100)\n"
+      "  -b first        id of the first node (default 1)\n"
+      "  -f frames       frames of each node (default 1000)\n"
+      "  -s seed         seed of the simulation (default 1)\n"
+      "  -c corrupt      frames corrupted [1/1000] (default 0)\n"
+      "  -d drop         frames dropped [1/1000] (default 0)\n"
+      "  -k connections  connections to the socket, the nodes are split among them (default 1)\n"
+      "  -u socket       write to this local socket (d7s_ingest -l)\n"
+      "  -o file         write to this file (default: stdout)\n", name);
+}
+
+static bool writeAll(int fd, const uint8_t *data, size_t len) {
+   while (len > 0) {
+      ssize_t written = write(fd, data, len);
+      if (written < 0) {
+         if (errno == EINTR) {
+            continue;
+         }
+         return false;
+      }
+      data += written;
+      len -= (size_t) written;
+   }
+   return true;
+}
+
+static int connectTo(const std::string &path) {
+   sockaddr_un address = {};
+   address.sun_family = AF_UNIX;
+   if (path.size() >= sizeof(address.sun_path)) {
+      return -1;
+   }
+   memcpy(address.sun_path, path.c_str(), path.size() + 1);
+   int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+   if (fd >= 0 && connect(fd, (const sockaddr *) &address, sizeof(address)) != 0) {
+      close(fd);
+      return -1;
+   }
+   return fd;
+}
+
+//send frames of each node of the fleet (the frames are batched into writes of about 64KiB)
+static bool run(d7s::Fleet &fleet, size_t frames, int fd) {
+   std::vector<uint8_t> buffer;
+   buffer.reserve(64 * 1024 + d7s::FRAME_MAX_SIZE);
+   uint8_t frame[d7s::FRAME_MAX_SIZE];
+   size_t total = frames * fleet.nodes();
+   for (size_t i = 0; i < total; i++) {
+      size_t size = fleet.next(frame);
+      buffer.insert(buffer.end(), frame, frame + size);
+      if (buffer.size() >= 64 * 1024) {
+         if (!writeAll(fd, buffer.data(), buffer.size())) {
+            return false;
+         }
+         buffer.clear();
+      }
+   }
+   return writeAll(fd, buffer.data(), buffer.size());
+}
+
+int main(int argc, char **argv) {
+   size_t nodes = 100;
+   unsigned first = 1;
+   size_t frames = 1000;
+   uint32_t seed = 1;
+   unsigned corrupt = 0;
+   unsigned drop = 0;
+   size_t connections = 1;
+   std::string socket;
+   std::string output;
+
+   int option;
+   while ((option = getopt(argc, argv, "n:b:f:s:c:d:k:u:o:h")) != -1) {
+      switch (option) {
+         case 'n': nodes = strtoul(optarg, nullptr, 0); break;
+         case 'b': first = (unsigned) strtoul(optarg, nullptr, 0); break;
+         case 'f': frames = strtoul(optarg, nullptr, 0); break;
+         case 's': seed = (uint32_t) strtoul(optarg, nullptr, 0); break;
+         case 'c': corrupt = (unsigned) atoi(optarg); break;
+         case 'd': drop = (unsigned) atoi(optarg); break;
+         case 'k': connections = strtoul(optarg, nullptr, 0); break;
+         case 'u': socket = optarg; break;
+         case 'o': output = optarg; break;
+         default: usage(argv[0]); return option == 'h' ? 0 : 2;
+      }
+   }
+   if (nodes == 0 || first + nodes > 65536 || connections == 0 || connections > nodes || corrupt + drop > 1000) {
+      usage(argv[0]);
+      return 2;
+   }
+   signal(SIGPIPE, SIG_IGN);
+
+   //a single stream
+   if (socket.empty()) {
+      int fd = output.empty() ? STDOUT_FILENO : open(output.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+      if (fd < 0) {
+         fprintf(stderr, "%s: %s\n", output.c_str(), strerror(errno));
+         return 1;
+      }
+      d7s::Fleet fleet(d7s::Fleet::range((uint16_t) first, nodes), seed, corrupt, drop);
+      bool ok = run(fleet, frames, fd);
+      if (fd != STDOUT_FILENO) {
+         close(fd);
+      }
+      return ok ? 0 : 1;
+   }
+
+   //a connection for each group of nodes (node first + i goes to the connection i % connections)
+   std::vector<std::thread> threads;
+   std::vector<int> results(connections, 0);
+   for (size_t c = 0; c < connections; c++) {
+      threads.emplace_back([&, c] {
+         std::vector<uint16_t> group;
+         for (size_t i = c; i < nodes; i += connections) {
+            group.push_back((uint16_t) (first + i));
+         }
+         int fd = connectTo(socket);
+         if (fd < 0) {
+            results[c] = 1;
+            return;
+         }
+         d7s::Fleet fleet(group, seed + (uint32_t) c, corrupt, drop);
+         results[c] = run(fleet, frames, fd) ? 0 : 1;
+         close(fd);
+      });
+   }
+   int status = 0;
+   for (size_t c = 0; c < connections; c++) {
+      threads[c].join();
+      if (results[c]) {
+         fprintf(stderr, "%s: connection %zu failed\n", socket.c_str(), c);
+         status = 1;
+      }
+   }
+   return status;
+}
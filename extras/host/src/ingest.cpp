@@ -0,0 +1,385 @@
+/*
+   Copyright 2017 Alessandro Pasqualini
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+     http://www.apache.org/licenses/LICENSE-2.0
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+
+   @author    Alessandro Pasqualini <alessandro.pasqualini.1105@gmail.com>
+   @url       https://github.com/alessandro1105
+
+   This project has been developed with the contribution of Futura Elettronica.
+   - http://www.futurashop.it
+   - http://www.elettronicain.it
+   - https://www.open-electronics.org
+*/
+
+#include "d7s/ingest.h"
+
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <unordered_map>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace d7s {
+
+//size of the reads of pipes and sockets
+static constexpr size_t READ_SIZE = 64 * 1024;
+
+//a source waiting to be handed to a worker
+struct Job {
+   int fd;
+   bool file; //regular file (mapped) or stream (epoll)
+   size_t size; //size of the file
+};
+
+struct Ingest::Worker {
+
+   Worker(Ingest &owner) : owner(owner), buffer(READ_SIZE) {
+      epoll = epoll_create1(EPOLL_CLOEXEC);
+      wake = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+      epoll_event event = {};
+      event.events = EPOLLIN;
+      event.data.fd = wake;
+      epoll_ctl(epoll, EPOLL_CTL_ADD, wake, &event);
+      thread = std::thread(&Worker::run, this);
+   }
+
+   ~Worker() {
+      stop();
+      //close the sources not ended
+      for (auto &stream : streams) {
+         ::close(stream.first);
+         owner.ended();
+      }
+      for (Job &job : pending) {
+         ::close(job.fd);
+         owner.ended();
+      }
+      ::close(wake);
+      ::close(epoll);
+   }
+
+   //stop the thread (its counters are final afterwards)
+   void stop() {
+      if (thread.joinable()) {
+         stopping.store(true);
+         notify();
+         thread.join();
+      }
+   }
+
+   //hand a source to the worker
+   void post(const Job &job) {
+      {
+         std::lock_guard<std::mutex> lock(mutex);
+         pending.push_back(job);
+      }
+      notify();
+   }
+
+   void notify() {
+      uint64_t one = 1;
+      ssize_t written = ::write(wake, &one, sizeof(one));
+      (void) written; //the counter is already set if it fails
+   }
+
+   void run() {
+      epoll_event events[64];
+      std::vector<Job> jobs;
+      while (!stopping.load()) {
+         //take the new sources
+         {
+            std::lock_guard<std::mutex> lock(mutex);
+            jobs.swap(pending);
+         }
+         for (Job &job : jobs) {
+            if (job.file) {
+               scanFile(job.fd, job.size);
+               continue;
+            }
+            epoll_event event = {};
+            event.events = EPOLLIN;
+            event.data.fd = job.fd;
+            if (epoll_ctl(epoll, EPOLL_CTL_ADD, job.fd, &event) != 0) {
+               ::close(job.fd);
+               owner.ended();
+               continue;
+            }
+            streams.emplace(job.fd, FrameScanner());
+         }
+         jobs.clear();
+
+         int ready = epoll_wait(epoll, events, 64, -1);
+         for (int i = 0; i < ready; i++) {
+            int fd = events[i].data.fd;
+            if (fd == wake) {
+               uint64_t counter;
+               ssize_t got = ::read(wake, &counter, sizeof(counter));
+               (void) got; //nothing to read if another wake-up already reset it
+               continue;
+            }
+            readStream(fd);
+         }
+      }
+   }
+
+   //a single read for each readiness (level triggered): a busy stream does not starve the others
+   void readStream(int fd) {
+      auto it = streams.find(fd);
+      if (it == streams.end()) {
+         return;
+      }
+      ssize_t got = ::read(fd, buffer.data(), buffer.size());
+      if (got > 0) {
+         feed(it->second, buffer.data(), (size_t) got);
+         return;
+      }
+      if (got < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+         return;
+      }
+      //end of the stream (or error)
+      finish(it->second);
+      epoll_ctl(epoll, EPOLL_CTL_DEL, fd, nullptr);
+      ::close(fd);
+      streams.erase(it);
+      owner.ended();
+   }
+
+   //scan a regular file in place (read in chunks if it cannot be mapped, e.g. files of /proc)
+   void scanFile(int fd, size_t size) {
+      FrameScanner scanner;
+      void *map = size ? mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+      if (map != MAP_FAILED) {
+         madvise(map, size, MADV_SEQUENTIAL);
+         feed(scanner, (const uint8_t *) map, size);
+         munmap(map, size);
+      } else {
+         ssize_t got;
+         while ((got = ::read(fd, buffer.data(), buffer.size())) > 0 || (got < 0 && errno == EINTR)) {
+            if (got > 0) {
+               feed(scanner, buffer.data(), (size_t) got);
+            }
+         }
+      }
+      finish(scanner);
+      ::close(fd);
+      owner.ended();
+   }
+
+   void feed(FrameScanner &scanner, const uint8_t *data, size_t len) {
+      ScanStats before = scanner.stats();
+      NodeTable &table = owner._table;
+      scanner.feed(data, len, [&table](const FrameView &frame) { table.update(frame); });
+      account(before, scanner.stats());
+   }
+
+   void finish(FrameScanner &scanner) {
+      ScanStats before = scanner.stats();
+      scanner.finish();
+      account(before, scanner.stats());
+   }
+
+   void account(const ScanStats &before, const ScanStats &after) {
+      frames.fetch_add(after.frames - before.frames, std::memory_order_relaxed);
+      bytes.fetch_add(after.bytes - before.bytes, std::memory_order_relaxed);
+      crcErrors.fetch_add(after.crcErrors - before.crcErrors, std::memory_order_relaxed);
+      lengthErrors.fetch_add(after.lengthErrors - before.lengthErrors, std::memory_order_relaxed);
+      skipped.fetch_add(after.skipped - before.skipped, std::memory_order_relaxed);
+   }
+
+   Ingest &owner;
+   int epoll = -1;
+   int wake = -1;
+   std::thread thread;
+   std::atomic<bool> stopping{false};
+   std::mutex mutex;
+   std::vector<Job> pending;
+   std::unordered_map<int, FrameScanner> streams;
+   std::vector<uint8_t> buffer;
+
+   //counters of the worker
+   std::atomic<uint64_t> frames{0};
+   std::atomic<uint64_t> bytes{0};
+   std::atomic<uint64_t> crcErrors{0};
+   std::atomic<uint64_t> lengthErrors{0};
+   std::atomic<uint64_t> skipped{0};
+};
+
+Ingest::Ingest(NodeTable &table, unsigned workers) : _table(table) {
+   if (workers == 0) {
+      workers = 1;
+   }
+   for (unsigned i = 0; i < workers; i++) {
+      _workers.emplace_back(new Worker(*this));
+   }
+}
+
+Ingest::~Ingest() {
+   stop();
+}
+
+bool Ingest::addFile(const std::string &path, std::string &error) {
+   int fd = path == "-" ? dup(STDIN_FILENO) : ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+   struct stat info;
+   if (fd < 0 || fstat(fd, &info) != 0) {
+      error = path + ": " + strerror(errno);
+      if (fd >= 0) {
+         ::close(fd);
+      }
+      return false;
+   }
+   if (S_ISREG(info.st_mode)) {
+      addFile(fd, (size_t) info.st_size);
+   } else {
+      //pipes, sockets and character devices (e.g. the serial port of a gateway)
+      addFd(fd);
+   }
+   return true;
+}
+
+void Ingest::addFile(int fd, size_t size) {
+   if (_workers.empty()) {
+      ::close(fd);
+      return;
+   }
+   _open.fetch_add(1);
+   next().post({fd, true, size});
+}
+
+void Ingest::addFd(int fd) {
+   if (_workers.empty()) {
+      ::close(fd);
+      return;
+   }
+   _open.fetch_add(1);
+   next().post({fd, false, 0});
+}
+
+bool Ingest::listen(const std::string &path, std::string &error) {
+   sockaddr_un address = {};
+   address.sun_family = AF_UNIX;
+   if (path.size() >= sizeof(address.sun_path)) {
+      error = path + ": path too long";
+      return false;
+   }
+   memcpy(address.sun_path, path.c_str(), path.size() + 1);
+
+   //remove a stale socket (never another kind of file)
+   struct stat info;
+   if (lstat(path.c_str(), &info) == 0 && S_ISSOCK(info.st_mode)) {
+      unlink(path.c_str());
+   }
+
+   int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+   if (fd < 0 || bind(fd, (const sockaddr *) &address, sizeof(address)) != 0 || ::listen(fd, SOMAXCONN) != 0) {
+      error = path + ": " + strerror(errno);
+      if (fd >= 0) {
+         ::close(fd);
+      }
+      return false;
+   }
+   _listenFd = fd;
+   _listenWake = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+   _listenPath = path;
+   _listener = std::thread(&Ingest::accept, this);
+   return true;
+}
+
+void Ingest::accept() {
+   pollfd fds[2] = {{_listenFd, POLLIN, 0}, {_listenWake, POLLIN, 0}};
+   for (;;) {
+      if (poll(fds, 2, -1) < 0) {
+         if (errno == EINTR) {
+            continue;
+         }
+         return;
+      }
+      if (fds[1].revents) {
+         return;
+      }
+      int fd = accept4(_listenFd, nullptr, nullptr, SOCK_CLOEXEC | SOCK_NONBLOCK);
+      if (fd >= 0) {
+         addFd(fd);
+      }
+   }
+}
+
+size_t Ingest::open() const {
+   return _open.load();
+}
+
+bool Ingest::wait(unsigned timeoutMs) {
+   std::unique_lock<std::mutex> lock(_mutex);
+   auto done = [this] { return _open.load() == 0; };
+   if (timeoutMs == 0) {
+      _idle.wait(lock, done);
+      return true;
+   }
+   return _idle.wait_for(lock, std::chrono::milliseconds(timeoutMs), done);
+}
+
+void Ingest::stop() {
+   if (_stopped) {
+      return;
+   }
+   _stopped = true;
+   //stop accepting first (no new sources for the workers)
+   if (_listener.joinable()) {
+      uint64_t one = 1;
+      ssize_t written = ::write(_listenWake, &one, sizeof(one));
+      (void) written;
+      _listener.join();
+      ::close(_listenFd);
+      ::close(_listenWake);
+      unlink(_listenPath.c_str());
+   }
+   //join the workers first, then keep their final counters
+   for (auto &worker : _workers) {
+      worker->stop();
+   }
+   _final = stats();
+   _workers.clear();
+}
+
+IngestStats Ingest::stats() const {
+   IngestStats stats = _final;
+   for (const auto &worker : _workers) {
+      stats.frames += worker->frames.load(std::memory_order_relaxed);
+      stats.bytes += worker->bytes.load(std::memory_order_relaxed);
+      stats.crcErrors += worker->crcErrors.load(std::memory_order_relaxed);
+      stats.lengthErrors += worker->lengthErrors.load(std::memory_order_relaxed);
+      stats.skipped += worker->skipped.load(std::memory_order_relaxed);
+   }
+   stats.sources = _ended.load();
+   return stats;
+}
+
+void Ingest::ended() {
+   _ended.fetch_add(1);
+   if (_open.fetch_sub(1) == 1) {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _idle.notify_all();
+   }
+}
+
+Ingest::Worker &Ingest::next() {
+   return *_workers[_next.fetch_add(1, std::memory_order_relaxed) % _workers.size()];
+}
+
+}
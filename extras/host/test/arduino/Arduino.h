@@ -0,0 +1,72 @@
+/*
+   Copyright 2017 Alessandro Pasqualini
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+     http://www.apache.org/licenses/LICENSE-2.0
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+
+   @author    Alessandro Pasqualini <alessandro.pasqualini.1105@gmail.com>
+   @url       https://github.com/alessandro1105
+
+   This project has been developed with the contribution of Futura Elettronica.
+   - http://www.futurashop.it
+   - http://www.elettronicain.it
+   - https://www.open-electronics.org
+*/
+
+//minimal Arduino core to build src/D7S.cpp on the host (device tests): time is simulated and advanced by delay()
+//it behaves as an AVR core (critical sections through SREG, bus recovery clocking the lines as GPIO)
+
+#ifndef D7S_HOST_ARDUINO_H
+#define D7S_HOST_ARDUINO_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#define ARDUINO_ARCH_AVR
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+#define CHANGE 1
+#define FALLING 2
+#define RISING 3
+#define DEC 10
+#define HEX 16
+#define SDA 20
+#define SCL 21
+
+typedef uint8_t byte;
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalRead(uint8_t pin);
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void attachInterrupt(uint8_t interrupt, void (*isr)(), int mode);
+void detachInterrupt(uint8_t interrupt);
+inline uint8_t digitalPinToInterrupt(uint8_t pin) { return pin; }
+void interrupts();
+void noInterrupts();
+extern volatile uint8_t SREG;
+void cli();
+
+//--- LINES ---
+//the lines are open drain: a line is low if the board (OUTPUT and LOW) or a device pulls it low, otherwise the pull-up holds it high
+void arduinoSetLevel(uint8_t pin, uint8_t level); //level driven by a device on the pin (e.g. INT1, INT2)
+void arduinoHoldSDA(uint8_t clocks); //a slave holds SDA low for the next clocks on SCL (0xFF: forever, 0: released)
+void arduinoHoldSCL(uint8_t hold); //a slave holds SCL low (true) or releases it
+uint16_t arduinoClocks(); //clocks generated by the board on SCL (rising edges)
+void arduinoInterrupt(uint8_t interrupt); //run the handler attached to the interrupt
+
+#endif
@@ -0,0 +1,68 @@
+/*
+   Copyright 2017 Alessandro Pasqualini
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+     http://www.apache.org/licenses/LICENSE-2.0
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+
+   @author    Alessandro Pasqualini <alessandro.pasqualini.1105@gmail.com>
+   @url       https://github.com/alessandro1105
+
+   This project has been developed with the contribution of Futura Elettronica.
+   - http://www.futurashop.it
+   - http://www.elettronicain.it
+   - https://www.open-electronics.org
+*/
+
+//Wire stand-in talking to a simulated D7S: a register file addressed by the 16 bit register address (auto-increment)
+//as the AVR Wire with a timeout, a transaction on a stuck bus (or a read from a D7S that hangs) lasts until the timeout
+
+#ifndef D7S_HOST_WIRE_H
+#define D7S_HOST_WIRE_H
+
+#include "Arduino.h"
+
+#define WIRE_HAS_TIMEOUT
+
+class TwoWire {
+
+   public:
+
+      void begin();
+      void end();
+      void setClock(uint32_t clock);
+      void setWireTimeout(uint32_t timeout, bool reset);
+      void beginTransmission(uint8_t address);
+      size_t write(uint8_t data);
+      uint8_t endTransmission(bool stop = true);
+      uint8_t requestFrom(int address, int len);
+      int available();
+      int read();
+
+      uint8_t registers[65536]; //registers of the D7S
+      uint8_t fail = 0; //status returned by endTransmission() (0 = the D7S answers)
+      uint16_t transactions = 0; //transmissions ended
+      uint8_t hang = 0; //the D7S acknowledges its address but holds the reads until the timeout
+      uint32_t timeout = 25000; //timeout [us] of the transactions
+
+   private:
+
+      uint8_t timedOut(uint8_t read);
+
+      uint8_t _address = 0;
+      uint8_t _tx[8];
+      uint8_t _txLen = 0;
+      uint16_t _pointer = 0;
+      uint8_t _rx[32];
+      uint8_t _rxLen = 0;
+      uint8_t _rxPos = 0;
+};
+
+extern TwoWire Wire;
+
+#endif
@@ -0,0 +1,156 @@
+/*
+   Copyright 2017 Alessandro Pasqualini
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+     http://www.apache.org/licenses/LICENSE-2.0
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+
+   @author    Alessandro Pasqualini <alessandro.pasqualini.1105@gmail.com>
+   @url       https://github.com/alessandro1105
+
+   This project has been developed with the contribution of Futura Elettronica.
+   - http://www.futurashop.it
+   - http://www.elettronicain.it
+   - https://www.open-electronics.org
+*/
+
+#include "Arduino.h"
+#include "Wire.h"
+
+//simulated time [us]
+static unsigned long now = 0;
+
+//--- LINES ---
+//board side of each pin (pinMode(), digitalWrite()) and level driven by the devices
+static uint8_t pinModes[64];
+static uint8_t pinOutputs[64];
+static uint8_t deviceLevels[64] = {
+   1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+   1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1
+};
+static uint8_t sdaHold = 0; //clocks left before the slave releases SDA
+static uint16_t clocks = 0;
+static void (*handlers[64])();
+
+static uint8_t level(uint8_t pin) {
+   pin &= 63;
+   //open drain: low if someone pulls the line low
+   if (pinModes[pin] == OUTPUT && pinOutputs[pin] == LOW) {
+      return LOW;
+   }
+   if (pin == SDA && sdaHold) {
+      return LOW;
+   }
+   return deviceLevels[pin];
+}
+
+//apply a change of the board side of a pin (a rising edge of SCL clocks the slave holding SDA)
+template <typename Change>
+static void change(uint8_t pin, Change apply) {
+   uint8_t before = level(pin);
+   apply();
+   if (pin == SCL && before == LOW && level(pin) == HIGH) {
+      clocks++;
+      if (sdaHold && sdaHold != 0xFF) {
+         sdaHold--;
+      }
+   }
+}
+
+void pinMode(uint8_t pin, uint8_t mode) { change(pin, [&] { pinModes[pin & 63] = mode; }); }
+void digitalWrite(uint8_t pin, uint8_t value) { change(pin, [&] { pinOutputs[pin & 63] = value; }); }
+int digitalRead(uint8_t pin) { return level(pin); }
+
+void arduinoSetLevel(uint8_t pin, uint8_t value) { deviceLevels[pin & 63] = value; }
+void arduinoHoldSDA(uint8_t hold) { sdaHold = hold; }
+void arduinoHoldSCL(uint8_t hold) { change(SCL, [&] { deviceLevels[SCL] = !hold; }); }
+uint16_t arduinoClocks() { return clocks; }
+
+//the time advances a bit at each read (the busy-wait loops end)
+unsigned long millis() { now += 10; return now / 1000; }
+unsigned long micros() { now += 1; return now; }
+void delay(unsigned long ms) { now += ms * 1000; }
+void delayMicroseconds(unsigned int us) { now += us; }
+
+void attachInterrupt(uint8_t interrupt, void (*isr)(), int) { handlers[interrupt & 63] = isr; }
+void detachInterrupt(uint8_t interrupt) { handlers[interrupt & 63] = nullptr; }
+void arduinoInterrupt(uint8_t interrupt) {
+   if (handlers[interrupt & 63]) {
+      handlers[interrupt & 63]();
+   }
+}
+void interrupts() {}
+void noInterrupts() {}
+volatile uint8_t SREG = 0;
+void cli() {}
+
+TwoWire Wire;
+
+void TwoWire::begin() {}
+void TwoWire::end() {}
+void TwoWire::setClock(uint32_t) {}
+void TwoWire::setWireTimeout(uint32_t value, bool) { timeout = value; }
+
+//a transaction on a stuck bus (or a read from a hanging D7S) lasts until the timeout (return true if it timed out)
+uint8_t TwoWire::timedOut(uint8_t read) {
+   if (!(read && hang) && digitalRead(SDA) == HIGH && digitalRead(SCL) == HIGH) {
+      return 0;
+   }
+   now += timeout;
+   return 1;
+}
+
+void TwoWire::beginTransmission(uint8_t address) {
+   _address = address;
+   _txLen = 0;
+}
+
+size_t TwoWire::write(uint8_t data) {
+   if (_txLen < sizeof(_tx)) {
+      _tx[_txLen++] = data;
+   }
+   return 1;
+}
+
+uint8_t TwoWire::endTransmission(bool) {
+   transactions++;
+   if (timedOut(0)) {
+      return 5;
+   }
+   if (fail) {
+      return fail;
+   }
+   //register address, then the data written
+   if (_txLen >= 2) {
+      _pointer = (_tx[0] << 8) | _tx[1];
+      for (uint8_t i = 2; i < _txLen; i++) {
+         registers[_pointer++] = _tx[i];
+      }
+   }
+   return 0;
+}
+
+uint8_t TwoWire::requestFrom(int, int len) {
+   _rxLen = 0;
+   _rxPos = 0;
+   if (timedOut(1) || fail) {
+      return 0;
+   }
+   for (int i = 0; i < len && _rxLen < sizeof(_rx); i++) {
+      _rx[_rxLen++] = registers[_pointer++];
+   }
+   return _rxLen;
+}
+
+int TwoWire::available() {
+   return _rxLen - _rxPos;
+}
+
+int TwoWire::read() {
+   return _rxPos < _rxLen ? _rx[_rxPos++] : -1;
+}
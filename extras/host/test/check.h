@@ -0,0 +1,58 @@
+/*
+   Copyright 2017 Alessandro Pasqualini
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+     http://www.apache.org/licenses/LICENSE-2.0
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+
+   @author    Alessandro Pasqualini <alessandro.pasqualini.1105@gmail.com>
+   @url       https://github.com/alessandro1105
+
+   This project has been developed with the contribution of Futura Elettronica.
+   - http://www.futurashop.it
+   - http://www.elettronicain.it
+   - https://www.open-electronics.org
+*/
+
+#ifndef D7S_HOST_TEST_CHECK_H
+#define D7S_HOST_TEST_CHECK_H
+
+#include <cstdio>
+
+//minimal checks of the host tests (no test framework is needed to build extras/host)
+static int checkFailures = 0;
+
+#define CHECK(condition) \
+   do { \
+      if (!(condition)) { \
+         fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+         checkFailures++; \
+      } \
+   } while (0)
+
+#define CHECK_EQ(a, b) \
+   do { \
+      long long checkA = (long long) (a); \
+      long long checkB = (long long) (b); \
+      if (checkA != checkB) { \
+         fprintf(stderr, "%s:%d: CHECK_EQ(%s, %s) failed: %lld != %lld\n", __FILE__, __LINE__, #a, #b, checkA, checkB); \
+         checkFailures++; \
+      } \
+   } while (0)
+
+//return the exit status of the test
+static int checkResult() {
+   if (checkFailures) {
+      fprintf(stderr, "%d checks failed\n", checkFailures);
+      return 1;
+   }
+   printf("all checks passed\n");
+   return 0;
+}
+
+#endif
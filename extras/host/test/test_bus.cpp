@@ -0,0 +1,129 @@
+/*
+   Copyright 2017 Alessandro Pasqualini
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+     http://www.apache.org/licenses/LICENSE-2.0
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+
+   @author    Alessandro Pasqualini <alessandro.pasqualini.1105@gmail.com>
+   @url       https://github.com/alessandro1105
+
+   This project has been developed with the contribution of Futura Elettronica.
+   - http://www.futurashop.it
+   - http://www.elettronicain.it
+   - https://www.open-electronics.org
+*/
+
+//recovery of a stuck bus: src/D7S.cpp on the stand-in Arduino core, whose lines are open drain (see arduino/Arduino.h)
+
+#include <D7S.h>
+
+#include "check.h"
+
+//the D7S is ready and the lines are idle
+static void reset() {
+   arduinoHoldSDA(0);
+   arduinoHoldSCL(0);
+   Wire.hang = 0;
+   Wire.registers[0x1000] = NORMAL_MODE;
+   Wire.registers[0x1001] = AXIS_YZ;
+   Wire.registers[0x1002] = 0;
+   D7S.resetEvents();
+   D7S.resetBusCounters();
+}
+
+//a slave holding SDA is clocked free and the read succeeds at the retry
+static void testRecovery() {
+   reset();
+   arduinoHoldSDA(5);
+   Wire.registers[0x1000] = NORMAL_MODE_NOT_IN_STANBY;
+   Wire.registers[0x1002] = 0x01;
+   uint16_t clocks = arduinoClocks();
+
+   CHECK_EQ(D7S.getState(), NORMAL_MODE_NOT_IN_STANBY);
+   CHECK_EQ(arduinoClocks() - clocks, 5);
+   CHECK_EQ(digitalRead(SDA), HIGH);
+   CHECK_EQ(D7S.getBusStatus(), D7S_BUS_OK);
+   CHECK_EQ(D7S.getBusStuckCount(), 1);
+   CHECK_EQ(D7S.getBusRecoveryCount(), 1);
+   CHECK_EQ(D7S.getBusErrorCount(), 0);
+
+   //the re-sync latched the events and the earthquake in progress (INT2 is not tracked)
+   Wire.registers[0x1002] = 0;
+   CHECK(D7S.isInShutoff());
+   CHECK(D7S.isEarthquakeOccuring());
+   //the Wire timeout is back to the one of the transactions
+   CHECK_EQ(Wire.timeout, D7S_I2C_TIMEOUT * 1000UL);
+}
+
+//a slave holding SDA beyond the nine clocks: the read gives up with the bus stuck
+static void testRecoveryFailure() {
+   reset();
+   arduinoHoldSDA(20);
+   uint16_t clocks = arduinoClocks();
+   uint16_t transactions = Wire.transactions;
+
+   CHECK_EQ(D7S.getState(), 0);
+   CHECK_EQ(arduinoClocks() - clocks, 9);
+   CHECK_EQ(digitalRead(SDA), LOW);
+   CHECK_EQ(D7S.getBusStatus(), D7S_BUS_STUCK);
+   CHECK_EQ(D7S.getBusStuckCount(), 1);
+   CHECK_EQ(D7S.getBusRecoveryCount(), 0);
+   CHECK_EQ(D7S.getBusErrorCount(), 1);
+   //no retry on a stuck bus
+   CHECK_EQ(Wire.transactions - transactions, 1);
+
+   //the bus is recovered once released
+   arduinoHoldSDA(0);
+   CHECK_EQ(D7S.getState(), NORMAL_MODE);
+   CHECK_EQ(D7S.getBusStatus(), D7S_BUS_OK);
+   CHECK_EQ(D7S.getBusErrorCount(), 1);
+}
+
+//a slave holding SCL: the recovery gives up within the recovery timeout
+static void testTimeBound() {
+   reset();
+   D7S.setBusRecoveryTimeout(20);
+   arduinoHoldSCL(1);
+   unsigned long start = millis();
+   CHECK(!D7S.recoverBus());
+   unsigned long elapsed = millis() - start;
+   CHECK(elapsed >= 20 && elapsed <= 21);
+   CHECK_EQ(D7S.getBusStatus(), D7S_BUS_STUCK);
+   CHECK_EQ(D7S.getBusRecoveryCount(), 0);
+   D7S.setBusRecoveryTimeout(D7S_BUS_RECOVERY_TIMEOUT);
+}
+
+//the lines are released but the D7S hangs the read: the re-sync (Wire transactions included) ends at the recovery deadline
+static void testDeadline() {
+   reset();
+   arduinoHoldSDA(3);
+   Wire.hang = 1;
+   unsigned long start = millis();
+   CHECK(!D7S.recoverBus());
+   unsigned long elapsed = millis() - start;
+   CHECK(elapsed <= D7S_BUS_RECOVERY_TIMEOUT + 1);
+   CHECK_EQ(digitalRead(SDA), HIGH);
+   CHECK_EQ(D7S.getBusStatus(), D7S_BUS_STUCK);
+   CHECK_EQ(D7S.getBusRecoveryCount(), 0);
+   CHECK_EQ(Wire.timeout, D7S_I2C_TIMEOUT * 1000UL);
+
+   //the D7S answers again
+   Wire.hang = 0;
+   CHECK(D7S.recoverBus());
+   CHECK_EQ(D7S.getBusRecoveryCount(), 1);
+}
+
+int main() {
+   D7S.begin();
+   testRecovery();
+   testRecoveryFailure();
+   testTimeBound();
+   testDeadline();
+   return checkResult();
+}
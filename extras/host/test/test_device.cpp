@@ -0,0 +1,221 @@
+/*
+   Copyright 2017 Alessandro Pasqualini
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+     http://www.apache.org/licenses/LICENSE-2.0
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+
+   @author    Alessandro Pasqualini <alessandro.pasqualini.1105@gmail.com>
+   @url       https://github.com/alessandro1105
+
+   This project has been developed with the contribution of Futura Elettronica.
+   - http://www.futurashop.it
+   - http://www.elettronicain.it
+   - https://www.open-electronics.org
+*/
+
+//device round-trip: the frames encoded by the library (src/D7S.cpp on the stand-in Arduino core) are parsed by the host
+
+#include <vector>
+
+#include <D7S.h>
+
+#include "check.h"
+#include "d7s/node_table.h"
+#include "d7s/scanner.h"
+
+//the names of the host that are not in the library (the events are the d7s_interrupt_event of the library)
+using d7s::FrameScanner;
+using d7s::FrameView;
+using d7s::NodeSnapshot;
+using d7s::NodeTable;
+using d7s::ParseResult;
+using d7s::EarthquakePayload;
+using d7s::EventPayload;
+using d7s::SamplePayload;
+using d7s::StatisticsPayload;
+using d7s::StatusPayload;
+using d7s::parseFrame;
+using d7s::FRAME_SYNC;
+using d7s::FRAME_HEADER_SIZE;
+using d7s::FRAME_MAX_SIZE;
+using d7s::FRAME_STATUS;
+using d7s::FRAME_EARTHQUAKE;
+using d7s::FRAME_SAMPLE;
+using d7s::FRAME_STATISTICS;
+using d7s::FRAME_EVENT;
+
+//frames encoded by the library
+static std::vector<uint8_t> stream;
+
+static FrameView parse(const uint8_t *frame, uint8_t size) {
+   CHECK(size > 0);
+   FrameView view;
+   CHECK(parseFrame(frame, size, view) == ParseResult::OK);
+   CHECK_EQ(view.size(), size);
+   CHECK_EQ(view.node(), 0x1234);
+   stream.insert(stream.end(), frame, frame + size);
+   return view;
+}
+
+//each warmStart() waits up to its timeout, the retries do not move the start of the time to ready
+static void testWarmStart() {
+   Wire.registers[0x1000] = INITIAL_INSTALLATION_MODE;
+   unsigned long start = millis();
+   CHECK_EQ(D7S.warmStart(100), WARM_START_BUSY);
+   CHECK(millis() - start >= 100);
+   unsigned long retry = millis();
+   CHECK_EQ(D7S.warmStart(100), WARM_START_BUSY);
+   CHECK(millis() - retry >= 100);
+   CHECK_EQ(D7S.getTimeToReady(), 0);
+
+   Wire.registers[0x1000] = NORMAL_MODE;
+   CHECK_EQ(D7S.warmStart(100), WARM_START_READY);
+   CHECK(D7S.getTimeToReady() >= 200);
+   CHECK(D7S.getTimeToReady() <= millis() - start);
+}
+
+static void testFrames() {
+   uint8_t frame[D7S_FRAME_MAX_SIZE];
+
+   //the host constants match the library
+   CHECK_EQ(FRAME_SYNC, D7S_FRAME_SYNC);
+   CHECK_EQ(FRAME_HEADER_SIZE, D7S_FRAME_HEADER_SIZE);
+   CHECK_EQ(FRAME_MAX_SIZE, D7S_FRAME_MAX_SIZE);
+   CHECK_EQ(FRAME_STATUS, D7S_FRAME_STATUS);
+   CHECK_EQ(FRAME_EARTHQUAKE, D7S_FRAME_EARTHQUAKE);
+   CHECK_EQ(FRAME_SAMPLE, D7S_FRAME_SAMPLE);
+   CHECK_EQ(FRAME_STATISTICS, D7S_FRAME_STATISTICS);
+   CHECK_EQ(FRAME_EVENT, D7S_FRAME_EVENT);
+   CHECK_EQ(d7s::START_EARTHQUAKE, START_EARTHQUAKE);
+   CHECK_EQ(d7s::END_EARTHQUAKE, END_EARTHQUAKE);
+   CHECK_EQ(d7s::SHUTOFF_EVENT, SHUTOFF_EVENT);
+   CHECK_EQ(d7s::COLLAPSE_EVENT, COLLAPSE_EVENT);
+
+   //STATE (0x1000), AXIS_STATE (0x1001), instantaneus SI (0x2000) and PGA (0x2002)
+   Wire.registers[0x1000] = NORMAL_MODE_NOT_IN_STANBY;
+   Wire.registers[0x1001] = AXIS_XY;
+   Wire.registers[0x2000] = 0x01;
+   Wire.registers[0x2001] = 0x64;
+   Wire.registers[0x2002] = 0x04;
+   Wire.registers[0x2003] = 0xB0;
+
+   D7S.begin();
+   D7S.setNodeId(0x1234);
+
+   FrameView view = parse(frame, D7S.encodeStatusFrame(frame));
+   StatusPayload status = {};
+   CHECK(decode(view, status));
+   CHECK_EQ(status.state, NORMAL_MODE_NOT_IN_STANBY);
+   CHECK_EQ(status.axis, AXIS_XY);
+   CHECK_EQ(status.events, 0);
+   CHECK_EQ(status.bus, D7S_BUS_OK);
+   CHECK_EQ(view.sequence(), 0);
+
+   unsigned long before = millis();
+   view = parse(frame, D7S.encodeSampleFrame(frame));
+   SamplePayload sample = {};
+   CHECK(decode(view, sample));
+   CHECK_EQ(sample.si, 356);
+   CHECK_EQ(sample.pga, 1200);
+   CHECK(sample.millis >= before && sample.millis <= millis());
+   CHECK_EQ(view.sequence(), 1);
+   CHECK_EQ(D7S.getPeakPGA() * 1000 + 0.5, 1200);
+
+   d7s_earthquake earthquake = {0.356, 1.2, -3.4};
+   view = parse(frame, D7S.encodeEarthquakeFrame(frame, earthquake));
+   EarthquakePayload record = {};
+   CHECK(decode(view, record));
+   CHECK_EQ(record.temperature, -34);
+   CHECK_EQ(record.si, 356);
+   CHECK_EQ(record.pga, 1200);
+
+   D7S.resetStatistics();
+   D7S.addToStatistics(earthquake);
+   d7s_earthquake strong = {0.4, 2.5, 20};
+   D7S.addToStatistics(strong);
+   d7s_statistics expected = D7S.getStatistics();
+   view = parse(frame, D7S.encodeStatisticsFrame(frame));
+   StatisticsPayload statistics = {};
+   CHECK(decode(view, statistics));
+   CHECK_EQ(statistics.count, 2);
+   CHECK_EQ(statistics.count, expected.count);
+   CHECK_EQ(statistics.maxSI, expected.maxSI);
+   CHECK_EQ(statistics.meanSI, expected.meanSI);
+   CHECK_EQ(statistics.maxPGA, expected.maxPGA);
+   CHECK_EQ(statistics.maxIntensity, expected.maxIntensity);
+   CHECK_EQ(statistics.maxSI, 400);
+   CHECK_EQ(statistics.maxPGA, 2500);
+
+   view = parse(frame, D7S.encodeEventFrame(frame, SHUTOFF_EVENT));
+   EventPayload event = {};
+   CHECK(decode(view, event));
+   CHECK_EQ(event.event, SHUTOFF_EVENT);
+   CHECK_EQ(event.state, NORMAL_MODE);
+}
+
+static void testBusError() {
+   uint8_t frame[D7S_FRAME_MAX_SIZE];
+
+   //the D7S does not answer: no sample, the status tells the data is not valid
+   Wire.fail = 2;
+   CHECK_EQ(D7S.encodeSampleFrame(frame), 0);
+   FrameView view = parse(frame, D7S.encodeStatusFrame(frame));
+   StatusPayload status = {};
+   CHECK(decode(view, status));
+   CHECK_EQ(status.bus, D7S_BUS_ERROR);
+   Wire.fail = 0;
+}
+
+//the SI [mm/s] at the bounds of the JMA classes (the ceiling of 10^((I - 2.4) / 2) cm/s)
+static void testJMAIntensity() {
+   const struct {
+      uint16_t si;
+      d7s_jma_intensity intensity;
+   } bounds[] = {
+      {0, JMA_0}, {1, JMA_0}, {2, JMA_1}, {3, JMA_1}, {4, JMA_2}, {11, JMA_2}, {12, JMA_3}, {35, JMA_3}, {36, JMA_4},
+      {112, JMA_4}, {113, JMA_5_LOWER}, {199, JMA_5_LOWER}, {200, JMA_5_UPPER}, {354, JMA_5_UPPER}, {355, JMA_6_LOWER},
+      {630, JMA_6_LOWER}, {631, JMA_6_UPPER}, {1122, JMA_6_UPPER}, {1123, JMA_7}, {65535, JMA_7}
+   };
+   for (const auto &bound : bounds) {
+      CHECK_EQ(D7S.getJMAIntensity(bound.si / 1000.0f), bound.intensity);
+   }
+}
+
+static void testStream() {
+   uint8_t frame[D7S_FRAME_MAX_SIZE];
+
+   //the sequence wraps without gaps
+   for (int i = 0; i < 600; i++) {
+      parse(frame, D7S.encodeEventFrame(frame, i % 2 ? END_EARTHQUAKE : START_EARTHQUAKE));
+   }
+
+   NodeTable table;
+   FrameScanner scanner;
+   scanner.feed(stream.data(), stream.size(), [&table](const FrameView &view) { table.update(view); });
+   CHECK_EQ(scanner.stats().frames, 606);
+   CHECK_EQ(scanner.stats().skipped, 0);
+   NodeSnapshot node;
+   CHECK(table.snapshot(0x1234, node));
+   CHECK_EQ(node.frames, 606);
+   CHECK_EQ(node.lost, 0);
+   CHECK_EQ(node.earthquakes, 1);
+   CHECK_EQ(node.events[START_EARTHQUAKE], 300);
+   CHECK_EQ(node.events[END_EARTHQUAKE], 300);
+   CHECK_EQ(node.events[SHUTOFF_EVENT], 1);
+   CHECK_EQ(node.maxSI, 400);
+}
+
+int main() {
+   testWarmStart();
+   testFrames();
+   testBusError();
+   testJMAIntensity();
+   testStream();
+   return checkResult();
+}
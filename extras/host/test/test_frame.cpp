@@ -0,0 +1,265 @@
+/*
+   Copyright 2017 Alessandro Pasqualini
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+     http://www.apache.org/licenses/LICENSE-2.0
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+
+   @author    Alessandro Pasqualini <alessandro.pasqualini.1105@gmail.com>
+   @url       https://github.com/alessandro1105
+
+   This project has been developed with the contribution of Futura Elettronica.
+   - http://www.futurashop.it
+   - http://www.elettronicain.it
+   - https://www.open-electronics.org
+*/
+
+//frame format: CRC-8, encoding, parsing, corruption and resync of the scanner
+
+#include <vector>
+
+#include "check.h"
+#include "d7s/frame.h"
+#include "d7s/scanner.h"
+
+using namespace d7s;
+
+static void testCrc() {
+   //CRC-8/SMBUS check value (polynomial 0x07, init 0x00)
+   const uint8_t check[] = {'1', '2', '3', '4', '5', '6', '7', '8', '9'};
+   CHECK_EQ(crc8(check, sizeof(check)), 0xF4);
+   CHECK_EQ(crc8(check, 0), 0x00);
+
+   //the table gives the CRC of the library (bit at a time) for any data
+   uint8_t data[256];
+   for (int i = 0; i < 256; i++) {
+      data[i] = (uint8_t) (i * 37 + 11);
+   }
+   for (size_t len = 0; len <= sizeof(data); len += 7) {
+      CHECK_EQ(crc8(data, len), crc8Bitwise(data, len));
+   }
+}
+
+static void testKnownFrame() {
+   //earthquake {si 0.356 m/s, pga 1.2 m/s^2, temperature -3.4 C} of node 0, sequence 0 (as encoded by the library)
+   const uint8_t expected[] = {0xD7, 0x02, 0x00, 0x00, 0x00, 0x06, 0xFF, 0xDE, 0x01, 0x64, 0x04, 0xB0, 0x57};
+   uint8_t frame[FRAME_MAX_SIZE];
+   CHECK_EQ(encode(frame, 0, 0, EarthquakePayload{-34, 356, 1200}), sizeof(expected));
+   CHECK(memcmp(frame, expected, sizeof(expected)) == 0);
+
+   FrameView view;
+   CHECK(parseFrame(expected, sizeof(expected), view) == ParseResult::OK);
+   CHECK(view.data() == expected);
+   CHECK_EQ(view.type(), FRAME_EARTHQUAKE);
+   CHECK_EQ(view.size(), sizeof(expected));
+   EarthquakePayload earthquake = {};
+   CHECK(decode(view, earthquake));
+   CHECK_EQ(earthquake.temperature, -34);
+   CHECK_EQ(earthquake.si, 356);
+   CHECK_EQ(earthquake.pga, 1200);
+   StatusPayload status = {};
+   CHECK(!decode(view, status));
+}
+
+static void testRoundTrip() {
+   uint8_t frame[FRAME_MAX_SIZE];
+   FrameView view;
+
+   size_t size = encode(frame, 0xBEEF, 200, StatusPayload{2, 3, 0x03, 1});
+   CHECK_EQ(size, FRAME_HEADER_SIZE + 4 + 1);
+   CHECK(parseFrame(frame, size, view) == ParseResult::OK);
+   CHECK_EQ(view.node(), 0xBEEF);
+   CHECK_EQ(view.sequence(), 200);
+   StatusPayload status = {};
+   CHECK(decode(view, status));
+   CHECK_EQ(status.state, 2);
+   CHECK_EQ(status.axis, 3);
+   CHECK_EQ(status.events, 0x03);
+   CHECK_EQ(status.bus, 1);
+
+   size = encode(frame, 7, 255, SamplePayload{0xFEDCBA98, 65535, 1});
+   CHECK_EQ(size, FRAME_HEADER_SIZE + 8 + 1);
+   CHECK(parseFrame(frame, size, view) == ParseResult::OK);
+   SamplePayload sample = {};
+   CHECK(decode(view, sample));
+   CHECK_EQ(sample.millis, 0xFEDCBA98u);
+   CHECK_EQ(sample.si, 65535);
+   CHECK_EQ(sample.pga, 1);
+
+   size = encode(frame, 1, 2, StatisticsPayload{513, 1122, 300, 4000, 6});
+   CHECK_EQ(size, FRAME_MAX_SIZE);
+   CHECK(parseFrame(frame, size, view) == ParseResult::OK);
+   StatisticsPayload statistics = {};
+   CHECK(decode(view, statistics));
+   CHECK_EQ(statistics.count, 513);
+   CHECK_EQ(statistics.maxSI, 1122);
+   CHECK_EQ(statistics.meanSI, 300);
+   CHECK_EQ(statistics.maxPGA, 4000);
+   CHECK_EQ(statistics.maxIntensity, 6);
+
+   size = encode(frame, 1, 3, EventPayload{COLLAPSE_EVENT, 0x02, 2});
+   CHECK_EQ(size, FRAME_HEADER_SIZE + 3 + 1);
+   CHECK(parseFrame(frame, size, view) == ParseResult::OK);
+   EventPayload event = {};
+   CHECK(decode(view, event));
+   CHECK_EQ(event.event, COLLAPSE_EVENT);
+   CHECK_EQ(event.events, 0x02);
+   CHECK_EQ(event.state, 2);
+
+   //unknown types are accepted if they fit
+   const uint8_t payload[FRAME_MAX_PAYLOAD + 1] = {0};
+   size = encodeFrame(frame, 0x7F, 1, 4, payload, 2);
+   CHECK(parseFrame(frame, size, view) == ParseResult::OK);
+   CHECK_EQ(encodeFrame(frame, 0x7F, 1, 4, payload, FRAME_MAX_PAYLOAD + 1), 0);
+}
+
+static void testParseErrors() {
+   uint8_t frame[FRAME_MAX_SIZE];
+   FrameView view;
+   size_t size = encode(frame, 42, 9, EarthquakePayload{250, 10, 20});
+   CHECK_EQ(size, FRAME_HEADER_SIZE + 6 + 1);
+   if (size == 0) {
+      return;
+   }
+
+   //truncated
+   for (size_t len = 0; len < size; len++) {
+      CHECK(parseFrame(frame, len, view) == ParseResult::NEED_MORE);
+   }
+
+   //every single bit flipped after the sync byte is detected
+   for (size_t at = 1; at < size; at++) {
+      for (int bit = 0; bit < 8; bit++) {
+         uint8_t copy[FRAME_MAX_SIZE];
+         memcpy(copy, frame, size);
+         copy[at] ^= 1 << bit;
+         CHECK(parseFrame(copy, size, view) != ParseResult::OK);
+      }
+   }
+
+   //sync byte
+   uint8_t copy[FRAME_MAX_SIZE];
+   memcpy(copy, frame, size);
+   copy[0] = 0xD6;
+   CHECK(parseFrame(copy, size, view) == ParseResult::BAD_SYNC);
+
+   //length not matching the type, length over the max size
+   memcpy(copy, frame, size);
+   copy[5] = 5;
+   CHECK(parseFrame(copy, size, view) == ParseResult::BAD_LENGTH);
+   memcpy(copy, frame, size);
+   copy[1] = 0x7F;
+   copy[5] = FRAME_MAX_PAYLOAD + 1;
+   CHECK(parseFrame(copy, size, view) == ParseResult::BAD_LENGTH);
+
+   //CRC
+   memcpy(copy, frame, size);
+   copy[size - 1] ^= 0xFF;
+   CHECK(parseFrame(copy, size, view) == ParseResult::BAD_CRC);
+}
+
+//a stream of frames with garbage in between
+static std::vector<uint8_t> stream(size_t frames, std::vector<uint16_t> &nodes) {
+   std::vector<uint8_t> data = {0x00, 0xD7, 0xD7, 0x12};
+   uint8_t frame[FRAME_MAX_SIZE];
+   for (size_t i = 0; i < frames; i++) {
+      size_t size;
+      switch (i % 5) {
+         case 0: size = encode(frame, (uint16_t) i, (uint8_t) i, StatusPayload{1, 2, 0, 0}); break;
+         case 1: size = encode(frame, (uint16_t) i, (uint8_t) i, EarthquakePayload{(int16_t) -i, 0xD7D7, 0xD7}); break;
+         case 2: size = encode(frame, (uint16_t) i, (uint8_t) i, SamplePayload{0xD7D7D7D7, 1, 2}); break;
+         case 3: size = encode(frame, (uint16_t) i, (uint8_t) i, StatisticsPayload{1, 2, 3, 4, 5}); break;
+         default: size = encode(frame, (uint16_t) i, (uint8_t) i, EventPayload{START_EARTHQUAKE, 0, 2}); break;
+      }
+      data.insert(data.end(), frame, frame + size);
+      nodes.push_back((uint16_t) i);
+      //garbage (a lone sync byte too) every few frames
+      if (i % 7 == 3) {
+         data.push_back(0xD7);
+         data.push_back(0x02);
+         data.push_back(0x55);
+      }
+   }
+   return data;
+}
+
+static void testScanner() {
+   std::vector<uint16_t> expected;
+   std::vector<uint8_t> data = stream(200, expected);
+
+   //the same frames whatever the size of the chunks
+   for (size_t chunk = 1; chunk <= 40; chunk++) {
+      FrameScanner scanner;
+      std::vector<uint16_t> nodes;
+      size_t inPlace = 0;
+      for (size_t at = 0; at < data.size(); at += chunk) {
+         size_t len = std::min(chunk, data.size() - at);
+         const uint8_t *begin = data.data() + at;
+         scanner.feed(begin, len, [&](const FrameView &frame) {
+            nodes.push_back(frame.node());
+            if (frame.data() >= begin && frame.data() < begin + len) {
+               inPlace++;
+            }
+         });
+      }
+      scanner.finish();
+      CHECK(nodes == expected);
+      CHECK_EQ(scanner.stats().frames, expected.size());
+      CHECK_EQ(scanner.stats().bytes, data.size());
+      CHECK_EQ(scanner.pending(), 0);
+      //in a single chunk every frame is passed in place
+      if (chunk == 40) {
+         CHECK(inPlace > expected.size() / 2);
+      }
+   }
+
+   FrameScanner scanner;
+   std::vector<uint16_t> nodes;
+   scanner.feed(data.data(), data.size(), [&](const FrameView &frame) {
+      CHECK(frame.data() >= data.data() && frame.data() < data.data() + data.size());
+      nodes.push_back(frame.node());
+   });
+   CHECK(nodes == expected);
+}
+
+static void testResync() {
+   uint8_t frame[FRAME_MAX_SIZE];
+   std::vector<uint8_t> data;
+   //a valid frame, a corrupted one, a truncated one and a valid one
+   size_t size = encode(frame, 1, 0, SamplePayload{1, 2, 3});
+   data.insert(data.end(), frame, frame + size);
+   size = encode(frame, 2, 0, SamplePayload{1, 2, 3});
+   frame[8] ^= 0x40;
+   data.insert(data.end(), frame, frame + size);
+   size = encode(frame, 3, 0, EarthquakePayload{1, 2, 3});
+   data.insert(data.end(), frame, frame + 5);
+   size = encode(frame, 4, 1, EarthquakePayload{1, 2, 3});
+   data.insert(data.end(), frame, frame + size);
+
+   FrameScanner scanner;
+   std::vector<uint16_t> nodes;
+   scanner.feed(data.data(), data.size(), [&](const FrameView &frame) { nodes.push_back(frame.node()); });
+   CHECK((nodes == std::vector<uint16_t>{1, 4}));
+   CHECK_EQ(scanner.stats().crcErrors, 1);
+
+   //a truncated frame at the end waits for the next chunk, then it is skipped at the end of the stream
+   scanner.feed(frame, 7, [&](const FrameView &) { CHECK(false); });
+   CHECK_EQ(scanner.pending(), 7);
+   scanner.finish();
+   CHECK_EQ(scanner.pending(), 0);
+}
+
+int main() {
+   testCrc();
+   testKnownFrame();
+   testRoundTrip();
+   testParseErrors();
+   testScanner();
+   testResync();
+   return checkResult();
+}
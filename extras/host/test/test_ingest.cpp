@@ -0,0 +1,179 @@
+/*
+   Copyright 2017 Alessandro Pasqualini
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+     http://www.apache.org/licenses/LICENSE-2.0
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+
+   @author    Alessandro Pasqualini <alessandro.pasqualini.1105@gmail.com>
+   @url       https://github.com/alessandro1105
+
+   This project has been developed with the contribution of Futura Elettronica.
+   - http://www.futurashop.it
+   - http://www.elettronicain.it
+   - https://www.open-electronics.org
+*/
+
+//ingest of simulated fleets from a file, a pipe and a local socket (corrupted and dropped frames included)
+
+#include <chrono>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <csignal>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "check.h"
+#include "d7s/fleet.h"
+#include "d7s/ingest.h"
+
+using namespace d7s;
+
+//the table must hold what the fleet sent
+static void compare(const NodeTable &table, const Fleet &fleet, const std::vector<uint16_t> &nodes) {
+   for (uint16_t id : nodes) {
+      const Fleet::Expected &expected = fleet.expected(id);
+      NodeSnapshot node;
+      CHECK(table.snapshot(id, node));
+      CHECK_EQ(node.frames, expected.frames);
+      CHECK_EQ(node.lost, expected.lost);
+      CHECK_EQ(node.earthquakes, expected.earthquakes);
+      CHECK_EQ(node.maxSI, expected.maxSI);
+      CHECK_EQ(node.maxPGA, expected.maxPGA);
+   }
+}
+
+static bool writeAll(int fd, const uint8_t *data, size_t len, size_t chunk) {
+   while (len > 0) {
+      ssize_t written = write(fd, data, std::min(len, chunk));
+      if (written <= 0) {
+         return false;
+      }
+      data += written;
+      len -= (size_t) written;
+   }
+   return true;
+}
+
+static void testFile() {
+   std::vector<uint16_t> nodes = Fleet::range(1, 50);
+   Fleet fleet(nodes, 3, 5, 5);
+   std::vector<uint8_t> data;
+   fleet.fill(data, 256 * 1024);
+
+   char path[] = "/tmp/d7s_ingest_XXXXXX";
+   int fd = mkstemp(path);
+   CHECK(fd >= 0);
+   CHECK(writeAll(fd, data.data(), data.size(), data.size()));
+   close(fd);
+
+   NodeTable table;
+   Ingest ingest(table, 2);
+   std::string error;
+   CHECK(ingest.addFile(path, error));
+   CHECK(!ingest.addFile("/nonexistent/d7s", error));
+   CHECK(!error.empty());
+   CHECK(ingest.wait(10000));
+   unlink(path);
+
+   IngestStats stats = ingest.stats();
+   CHECK_EQ(stats.bytes, data.size());
+   CHECK_EQ(stats.sources, 1);
+   CHECK(stats.crcErrors + stats.lengthErrors > 0);
+   CHECK_EQ(table.active(), nodes.size());
+   compare(table, fleet, nodes);
+}
+
+static void testPipe() {
+   std::vector<uint16_t> nodes = Fleet::range(1000, 200);
+   Fleet fleet(nodes, 5, 2, 2);
+   std::vector<uint8_t> data;
+   fleet.fill(data, 512 * 1024);
+
+   int fds[2];
+   CHECK(pipe(fds) == 0);
+   NodeTable table;
+   Ingest ingest(table, 3);
+   ingest.addFd(fds[0]);
+   //odd sized writes (frames split across the reads)
+   std::thread writer([&] {
+      CHECK(writeAll(fds[1], data.data(), data.size(), 1001));
+      close(fds[1]);
+   });
+   writer.join();
+   CHECK(ingest.wait(10000));
+
+   CHECK_EQ(ingest.stats().bytes, data.size());
+   CHECK_EQ(table.active(), nodes.size());
+   compare(table, fleet, nodes);
+}
+
+static void testSocket() {
+   std::string path = "/tmp/d7s_ingest_" + std::to_string(getpid()) + ".sock";
+   NodeTable table;
+   Ingest ingest(table, 2);
+   std::string error;
+   CHECK(ingest.listen(path, error));
+
+   //four gateways, each with its own nodes
+   const size_t gateways = 4;
+   std::vector<std::vector<uint16_t>> nodes;
+   std::vector<Fleet> fleets;
+   for (size_t g = 0; g < gateways; g++) {
+      nodes.push_back(Fleet::range((uint16_t) (20000 + g * 1000), 100));
+      fleets.emplace_back(nodes[g], 11 + (uint32_t) g, 3, 3);
+   }
+   std::vector<std::thread> threads;
+   for (size_t g = 0; g < gateways; g++) {
+      threads.emplace_back([&, g] {
+         std::vector<uint8_t> data;
+         fleets[g].fill(data, 128 * 1024);
+         sockaddr_un address = {};
+         address.sun_family = AF_UNIX;
+         memcpy(address.sun_path, path.c_str(), path.size() + 1);
+         int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+         CHECK(connect(fd, (const sockaddr *) &address, sizeof(address)) == 0);
+         CHECK(writeAll(fd, data.data(), data.size(), 4096 + g));
+         close(fd);
+      });
+   }
+   for (std::thread &thread : threads) {
+      thread.join();
+   }
+
+   //the connections are accepted asynchronously
+   for (int i = 0; i < 1000 && ingest.stats().sources < gateways; i++) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+   }
+   CHECK_EQ(ingest.stats().sources, gateways);
+   ingest.stop();
+   CHECK(access(path.c_str(), F_OK) != 0);
+
+   CHECK_EQ(table.active(), gateways * 100);
+   uint64_t frames = 0;
+   for (size_t g = 0; g < gateways; g++) {
+      compare(table, fleets[g], nodes[g]);
+      for (uint16_t id : nodes[g]) {
+         frames += fleets[g].expected(id).frames;
+      }
+   }
+   //the counters kept after stop() are the final ones of the workers
+   CHECK_EQ(ingest.stats().frames, frames);
+}
+
+int main() {
+   signal(SIGPIPE, SIG_IGN);
+   testFile();
+   testPipe();
+   testSocket();
+   return checkResult();
+}
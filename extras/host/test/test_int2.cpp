@@ -0,0 +1,133 @@
+/*
+   Copyright 2017 Alessandro Pasqualini
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+     http://www.apache.org/licenses/LICENSE-2.0
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+
+   @author    Alessandro Pasqualini <alessandro.pasqualini.1105@gmail.com>
+   @url       https://github.com/alessandro1105
+
+   This project has been developed with the contribution of Futura Elettronica.
+   - http://www.futurashop.it
+   - http://www.elettronicain.it
+   - https://www.open-electronics.org
+*/
+
+//INT2 tracking: src/D7S.cpp on the stand-in Arduino core, the edges of INT2 run the handler attached by the library
+
+#include <D7S.h>
+
+#include "check.h"
+
+#define INT2_PIN 3
+
+static int starts = 0;
+static int ends = 0;
+static int nested = 0;
+
+static void onStart(void *) {
+   starts++;
+   //an edge occured while the handler runs is left to it (not counted as filtered)
+   if (nested) {
+      nested = 0;
+      arduinoInterrupt(INT2_PIN);
+   }
+}
+
+static void onEnd(void *) {
+   ends++;
+}
+
+//INT2 goes to the level with the D7S in the state
+static void edge(uint8_t level, d7s_status state) {
+   Wire.registers[0x1000] = state;
+   arduinoSetLevel(INT2_PIN, level);
+   arduinoInterrupt(INT2_PIN);
+}
+
+static void reset() {
+   starts = 0;
+   ends = 0;
+   D7S.resetStatistics();
+   D7S.clearJournal();
+}
+
+//an earthquake is dispatched, recorded in the statistics and filtered edges are counted once
+static void testEarthquake() {
+   reset();
+   uint16_t filtered = D7S.getINT2FilteredCount();
+   nested = 1;
+   edge(LOW, NORMAL_MODE_NOT_IN_STANBY);
+   CHECK_EQ(starts, 1);
+   CHECK(D7S.isEarthquakeOccuring());
+   CHECK_EQ(D7S.getINT2FilteredCount(), filtered);
+
+   //a duplicated edge
+   edge(LOW, NORMAL_MODE_NOT_IN_STANBY);
+   CHECK_EQ(D7S.getINT2FilteredCount(), filtered + 1);
+
+   edge(HIGH, NORMAL_MODE);
+   CHECK_EQ(ends, 1);
+   CHECK(!D7S.isEarthquakeOccuring());
+   CHECK_EQ(D7S.getStatistics().count, 1);
+   CHECK_EQ(D7S.getJournalCount(), 2);
+}
+
+//INT2 is low during selftest, offset acquisition and installation: no earthquake
+static void testModes() {
+   const d7s_status modes[] = {SELFTEST_MODE, OFFSET_ACQUISITION_MODE, INITIAL_INSTALLATION_MODE};
+   for (d7s_status mode : modes) {
+      reset();
+      edge(LOW, mode);
+      CHECK(!D7S.isEarthquakeOccuring());
+      edge(HIGH, NORMAL_MODE);
+      CHECK_EQ(starts, 0);
+      CHECK_EQ(ends, 0);
+      CHECK_EQ(D7S.getStatistics().count, 0);
+      CHECK_EQ(D7S.getJournalCount(), 0);
+   }
+}
+
+//the edges missed before the interrupt handling starts: only an earthquake is resumed
+static void testResume() {
+   //a selftest started while the handling was stopped
+   reset();
+   D7S.stopInterruptHandling();
+   Wire.registers[0x1000] = SELFTEST_MODE;
+   arduinoSetLevel(INT2_PIN, LOW);
+   D7S.startInterruptHandling();
+   CHECK_EQ(starts, 0);
+   CHECK(!D7S.isEarthquakeOccuring());
+   edge(HIGH, NORMAL_MODE);
+   CHECK_EQ(ends, 0);
+
+   //an earthquake started while the handling was stopped
+   D7S.stopInterruptHandling();
+   Wire.registers[0x1000] = NORMAL_MODE_NOT_IN_STANBY;
+   arduinoSetLevel(INT2_PIN, LOW);
+   D7S.startInterruptHandling();
+   CHECK_EQ(starts, 1);
+   CHECK(D7S.isEarthquakeOccuring());
+   edge(HIGH, NORMAL_MODE);
+   CHECK_EQ(ends, 1);
+   CHECK_EQ(D7S.getStatistics().count, 1);
+}
+
+int main() {
+   D7S.begin();
+   Wire.registers[0x1000] = NORMAL_MODE;
+   D7S.enableInterruptINT2(INT2_PIN);
+   D7S.registerInterruptEventHandler(START_EARTHQUAKE, &onStart, NULL);
+   D7S.registerInterruptEventHandler(END_EARTHQUAKE, &onEnd, NULL);
+   D7S.startInterruptHandling();
+   testEarthquake();
+   testModes();
+   testResume();
+   return checkResult();
+}
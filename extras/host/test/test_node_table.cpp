@@ -0,0 +1,135 @@
+/*
+   Copyright 2017 Alessandro Pasqualini
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+     http://www.apache.org/licenses/LICENSE-2.0
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+
+   @author    Alessandro Pasqualini <alessandro.pasqualini.1105@gmail.com>
+   @url       https://github.com/alessandro1105
+
+   This project has been developed with the contribution of Futura Elettronica.
+   - http://www.futurashop.it
+   - http://www.elettronicain.it
+   - https://www.open-electronics.org
+*/
+
+//node table: sequence gaps, values of each frame type, concurrent updates
+
+#include <thread>
+#include <vector>
+
+#include "check.h"
+#include "d7s/node_table.h"
+
+using namespace d7s;
+
+static void update(NodeTable &table, const uint8_t *frame) {
+   table.update(FrameView(frame));
+}
+
+static void testSequence() {
+   NodeTable table;
+   uint8_t frame[FRAME_MAX_SIZE];
+   NodeSnapshot node;
+   CHECK(!table.snapshot(9, node));
+
+   //250, 251, 253 (one lost), 0 (two lost across the wrap), 1
+   const uint8_t sequences[] = {250, 251, 253, 0, 1};
+   for (uint8_t sequence : sequences) {
+      encode(frame, 9, sequence, StatusPayload{1, 2, 0, 0});
+      update(table, frame);
+   }
+   CHECK(table.snapshot(9, node));
+   CHECK_EQ(node.frames, 5);
+   CHECK_EQ(node.lost, 3);
+   CHECK_EQ(table.active(), 1);
+}
+
+static void testValues() {
+   NodeTable table;
+   uint8_t frame[FRAME_MAX_SIZE];
+   NodeSnapshot node;
+
+   encode(frame, 65535, 0, StatusPayload{2, 3, 0x01, 1});
+   update(table, frame);
+   encode(frame, 65535, 1, SamplePayload{100, 300, 2000});
+   update(table, frame);
+   encode(frame, 65535, 2, SamplePayload{200, 100, 500});
+   update(table, frame);
+   encode(frame, 65535, 3, EarthquakePayload{-55, 280, 1900});
+   update(table, frame);
+   encode(frame, 65535, 4, EventPayload{END_EARTHQUAKE, 0x02, 1});
+   update(table, frame);
+   encode(frame, 65535, 5, StatisticsPayload{4, 400, 200, 1000, 5});
+   update(table, frame);
+
+   CHECK(table.snapshot(65535, node));
+   CHECK_EQ(node.frames, 6);
+   CHECK_EQ(node.lost, 0);
+   CHECK_EQ(node.earthquakes, 1);
+   CHECK_EQ(node.events[END_EARTHQUAKE], 1);
+   CHECK_EQ(node.events[START_EARTHQUAKE], 0);
+   CHECK_EQ(node.state, 1);
+   CHECK_EQ(node.eventBits, 0x02);
+   CHECK_EQ(node.bus, 1);
+   CHECK_EQ(node.temperature, -55);
+   CHECK_EQ(node.lastSI, 280);
+   CHECK_EQ(node.lastPGA, 1900);
+   CHECK_EQ(node.maxSI, 400);
+   CHECK_EQ(node.maxPGA, 2000);
+   CHECK_EQ(node.maxIntensity, 5);
+
+   size_t count = 0;
+   table.forEach([&](const NodeSnapshot &snap) {
+      CHECK_EQ(snap.node, 65535);
+      count++;
+   });
+   CHECK_EQ(count, 1);
+}
+
+static void testConcurrent() {
+   //each thread owns some nodes and shares the max of one node with the others
+   NodeTable table;
+   const unsigned threads = 4;
+   const unsigned frames = 10000;
+   std::vector<std::thread> workers;
+   for (unsigned t = 0; t < threads; t++) {
+      workers.emplace_back([&table, t] {
+         uint8_t frame[FRAME_MAX_SIZE];
+         for (unsigned i = 0; i < frames; i++) {
+            uint16_t node = (uint16_t) (1 + t * 100 + i % 100);
+            encode(frame, node, (uint8_t) (i / 100), SamplePayload{i, (uint16_t) (i % 1000), 0});
+            table.update(FrameView(frame));
+            encode(frame, 0, 0, StatisticsPayload{1, (uint16_t) (t * frames + i), 0, 0, 0});
+            table.update(FrameView(frame));
+         }
+      });
+   }
+   for (std::thread &worker : workers) {
+      worker.join();
+   }
+   CHECK_EQ(table.active(), threads * 100 + 1);
+   NodeSnapshot node;
+   for (unsigned n = 1; n <= threads * 100; n++) {
+      CHECK(table.snapshot((uint16_t) n, node));
+      CHECK_EQ(node.frames, frames / 100);
+      CHECK_EQ(node.lost, 0);
+      CHECK_EQ(node.maxSI, 900 + (n - 1) % 100);
+   }
+   CHECK(table.snapshot(0, node));
+   CHECK_EQ(node.frames, threads * frames);
+   CHECK_EQ(node.maxSI, threads * frames - 1);
+}
+
+int main() {
+   testSequence();
+   testValues();
+   testConcurrent();
+   return checkResult();
+}
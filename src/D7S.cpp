@@ -21,25 +21,172 @@
 
 #include "D7S.h"
 
+//lower bound of the SI [mm/s] of each JMA intensity class (from JMA_1 to JMA_7)
+//from the empirical relation I = 2 * log10(SI [cm/s]) + 2.4: the ceiling of 10^((I - 2.4) / 2) cm/s in mm/s
+//for the class bounds I = 0.5, 1.5, 2.5, 3.5, 4.5, 5.0, 5.5, 6.0, 6.5
+static const uint16_t JMA_SI_THRESHOLDS[9] = {2, 4, 12, 36, 113, 200, 355, 631, 1123};
+
+//----------------------- D7S CONFIGURATION -----------------------
+
+//--- CONSTRUCTOR ---
+//empty configuration
+D7SConfig::D7SConfig() {
+   _fields = 0;
+   _axis = 0;
+   _threshold = 0;
+   _clearMask = 0;
+   _initialize = 0;
+}
+
+//--- SETTINGS ---
+//set the axis selection mode
+D7SConfig &D7SConfig::setAxis(d7s_axis_settings axisMode) {
+   //check if axisMode is valid
+   if (axisMode >= 0 && axisMode <= 4) {
+      _axis = axisMode;
+      _fields |= 0x01;
+   }
+   return *this;
+}
+
+//set the threshold
+D7SConfig &D7SConfig::setThreshold(d7s_threshold threshold) {
+   //check if threshold is valid
+   if (threshold >= 0 && threshold <= 1) {
+      _threshold = threshold;
+      _fields |= 0x02;
+   }
+   return *this;
+}
+
+//delete the specified data (D7S_CLEAR_*)
+D7SConfig &D7SConfig::clear(uint8_t clearMask) {
+   _clearMask |= clearMask & D7S_CLEAR_ALL;
+   return *this;
+}
+
+//start the initial installation mode after the settings
+D7SConfig &D7SConfig::initialize() {
+   _initialize = 1;
+   return *this;
+}
+
+//--- APPLY ---
+//apply the configuration to the D7S (return D7S_CONFIG_OK or the mismatches found)
+uint8_t D7SConfig::apply() {
+   return D7S.applyConfig(*this);
+}
+
+
 //----------------------- PUBLIC INTERFACE -----------------------
 
 //--- CONSTRUCTOR/DESTROYER ---
 D7SClass::D7SClass() {
-   //reset handler array
-   for (int i = 0; i < 4; i++) {
-      _handlers[i] = NULL;
+   //reset handler table
+   for (int i = 0; i < D7S_MAX_HANDLERS; i++) {
+      _handlers[i].kind = HANDLER_NONE;
    }
 
    //reset events variable
    _events = 0;
 
+   //reset earthquake tracking
+   _earthquakeOccuring = 0;
+   _int2MinPulseWidth = D7S_INT2_MIN_PULSE_WIDTH;
+   _int2Filtered = 0;
+   _int2Busy = 0;
+   _int2Attached = 0;
+   _int2Mode = 0;
+   _resumeEarthquake = 0;
+
+   //reset time to ready
+   _beginTime = 0;
+   _begun = 0;
+   _timeToReady = 0;
+   _readySeen = 0;
+
+   //reset event journal (clearJournal() is not used: interrupts must not be touched before setup())
+   _journalHead = 0;
+   _journalCount = 0;
+   _journalOverflow = 0;
+
+   //reset statistics (resetStatistics() is not used: interrupts must not be touched before setup())
+   _statCount = 0;
+   _statSumSI = 0;
+   _statMaxSI = 0;
+   _statMaxPGA = 0;
+   _peakPGA = 0;
+
+   //reset telemetry frames
+   _nodeId = 0;
+   _frameSequence = 0;
+
+   //reset i2c bus state
+   _busStatus = D7S_BUS_OK;
+   _busRecoveryTimeout = D7S_BUS_RECOVERY_TIMEOUT;
+   _busRecovering = 0;
+   resetBusCounters();
+
 }
 
 //--- BEGIN ---
 //used to initialize Wire
 void D7SClass::begin() {
+   //save the time of the first begin (used for the time to ready, the retries of warmStart() do not move it)
+   if (!_begun) {
+      _beginTime = millis();
+      _begun = 1;
+   }
    //begin Wire
-   WireD7S.begin();
+   beginWire();
+}
+
+//initialize Wire and resume the D7S in the state it is (without installation)
+//after a reboot the D7S keeps its installation data, so it's not needed to run initialize() again
+d7s_warm_start D7SClass::warmStart(uint16_t timeout) {
+   //start time of this attempt (used for the timeout)
+   unsigned long start = millis();
+
+   //begin Wire
+   begin();
+
+   //forget the earthquake resumed by a previus warm start
+   _resumeEarthquake = 0;
+
+   //wait until the D7S answers and leaves installation/offset/selftest mode (up to timeout ms)
+   //after a brown-out the D7S may not answer for a while, so a failed read is retried too
+   uint8_t answered = 0;
+   while (1) {
+      //read STATE (0x1000), AXIS_STATE (0x1001) and EVENT (0x1002) at once
+      uint8_t data[3];
+      if (readRegister(0x10, 0x00, data, 3, 0)) {
+         answered = 1;
+         //latch the events (the EVENT register is cleared by the read)
+         _events |= data[2] & 0x0F;
+
+         d7s_status state = (d7s_status) (data[0] & 0x07);
+         //the D7S is installed and ready
+         if (state == NORMAL_MODE) {
+            updateReady(state);
+            _earthquakeOccuring = 0;
+            return WARM_START_READY;
+         }
+         //the D7S is installed and an earthquake is in progress
+         if (state == NORMAL_MODE_NOT_IN_STANBY) {
+            updateReady(state);
+            //resume the earthquake (START_EARTHQUAKE is dispatched when the interrupt handling starts)
+            _earthquakeOccuring = 1;
+            _resumeEarthquake = 1;
+            resetPeakPGA();
+            return WARM_START_EARTHQUAKE;
+         }
+      }
+      //timeout
+      if (millis() - start >= timeout) {
+         return answered ? WARM_START_BUSY : WARM_START_ERROR;
+      }
+      delay(10);
+   }
 }
 
 //--- STATUS ---
@@ -84,11 +231,66 @@ void D7SClass::setAxis(d7s_axis_settings axisMode) {
    write8bit(0x10, 0x04, reg);
 }
 
+//--- CONFIGURATION ---
+//apply the configuration with the minimum writes and verify it (return D7S_CONFIG_OK or the mismatches found)
+//the transactions are issued back to back (without the delays used by the single settings)
+uint8_t D7SClass::applyConfig(const D7SConfig &config) {
+   uint8_t result = D7S_CONFIG_OK;
+
+   //--- CTRL ---
+   if (config._fields) {
+      //read the CTRL register at 0x1004
+      uint8_t reg;
+      if (!readRegister(0x10, 0x04, &reg, 1, 0)) {
+         return D7S_CONFIG_BUS_ERROR;
+      }
+      //desired register value (axis mode in bits 6-4, threshold in bit 3)
+      uint8_t desired = reg;
+      if (config._fields & 0x01) {
+         desired = (desired & 0x8F) | (config._axis << 4);
+      }
+      if (config._fields & 0x02) {
+         desired = (desired & 0xF7) | (config._threshold << 3);
+      }
+      //update the register only if needed and verify it with a single readback
+      if (desired != reg) {
+         if (!write8bit(0x10, 0x04, desired, 0) || !readRegister(0x10, 0x04, &reg, 1, 0)) {
+            return D7S_CONFIG_BUS_ERROR;
+         }
+         //report the mismatches
+         if ((reg & 0x70) != (desired & 0x70)) {
+            result |= D7S_CONFIG_AXIS_MISMATCH;
+         }
+         if ((reg & 0x08) != (desired & 0x08)) {
+            result |= D7S_CONFIG_THRESHOLD_MISMATCH;
+         }
+      }
+   }
+
+   //--- CLEAR COMMAND ---
+   if (config._clearMask) {
+      //write clear command (all the data at once)
+      if (!write8bit(0x10, 0x05, config._clearMask, 0)) {
+         result |= D7S_CONFIG_BUS_ERROR;
+      }
+   }
+
+   //--- INITIALIZATION ---
+   if (config._initialize) {
+      //write INITIAL INSTALLATION MODE command
+      if (!write8bit(0x10, 0x03, 0x02, 0)) {
+         result |= D7S_CONFIG_BUS_ERROR;
+      }
+   }
+
+   return result;
+}
+
 //--- LASTEST DATA ---
 //get the lastest SI at specified index (up to 5) [m/s]
 float D7SClass::getLastestSI(uint8_t index) {
    //check if the index is in bound
-   if (index < 0 || index > 4) {
+   if (index > 4) {
       return 0;
    }
    //return the value
@@ -98,7 +300,7 @@ float D7SClass::getLastestSI(uint8_t index) {
 //get the lastest PGA at specified index (up to 5) [m/s^2]
 float D7SClass::getLastestPGA(uint8_t index) {
    //check if the index is in bound
-   if (index < 0 || index > 4) {
+   if (index > 4) {
       return 0;
    }
    //return the value
@@ -108,18 +310,28 @@ float D7SClass::getLastestPGA(uint8_t index) {
 //get the lastest Temperature at specified index (up to 5) [Celsius]
 float D7SClass::getLastestTemperature(uint8_t index) {
    //check if the index is in bound
-   if (index < 0 || index > 4) {
+   if (index > 4) {
       return 0;
    }
    //return the value
    return (float) ((int16_t) read16bit(0x30 + index, 0x06)) / 10;
 }
 
+//get the lastest earthquake data at specified index (up to 5)
+d7s_earthquake D7SClass::getLastestEarthquake(uint8_t index) {
+   //check if the index is in bound
+   if (index > 4) {
+      return d7s_earthquake();
+   }
+   //return the value
+   return readEarthquake(0x30 + index);
+}
+
 //--- RANKED DATA ---
 //get the ranked SI at specified position (up to 5) [m/s]
 float D7SClass::getRankedSI(uint8_t position) {
    //check if the position is in bound
-   if (position < 0 || position > 4) {
+   if (position > 4) {
       return 0;
    }
    //return the value
@@ -129,7 +341,7 @@ float D7SClass::getRankedSI(uint8_t position) {
 //get the ranked PGA at specified position (up to 5) [m/s^2]
 float D7SClass::getRankedPGA(uint8_t position) {
    //check if the position is in bound
-   if (position < 0 || position > 4) {
+   if (position > 4) {
       return 0;
    }
    //return the value
@@ -139,13 +351,23 @@ float D7SClass::getRankedPGA(uint8_t position) {
 //get the ranked Temperature at specified position (up to 5) [Celsius]
 float D7SClass::getRankedTemperature(uint8_t position) {
    //check if the position is in bound
-   if (position < 0 || position > 4) {
+   if (position > 4) {
       return 0;
    }
    //return the value
    return (float) ((int16_t) read16bit(0x30 + position +5, 0x06)) / 10;
 }
 
+//get the ranked earthquake data at specified position (up to 5)
+d7s_earthquake D7SClass::getRankedEarthquake(uint8_t position) {
+   //check if the position is in bound
+   if (position > 4) {
+      return d7s_earthquake();
+   }
+   //return the value
+   return readEarthquake(0x30 + position +5);
+}
+
 //--- INSTANTANEUS DATA ---
 //get instantaneus SI (during an earthquake) [m/s]
 float D7SClass::getInstantaneusSI() {
@@ -155,8 +377,167 @@ float D7SClass::getInstantaneusSI() {
 
 //get instantaneus PGA (during an earthquake) [m/s^2]
 float D7SClass::getInstantaneusPGA() {
+   //read the value
+   uint16_t pga = read16bit(0x20, 0x02);
+   //update the peak of the current earthquake
+   updatePeakPGA(pga);
    //return the value
-   return ((float) read16bit(0x20, 0x02)) / 1000;
+   return ((float) pga) / 1000;
+}
+
+//--- STATISTICS ---
+//estimate the JMA seismic intensity from the SI [m/s]
+d7s_jma_intensity D7SClass::getJMAIntensity(float si) {
+   return jmaIntensity(toFixedPoint(si));
+}
+
+//add an earthquake to the statistics of the current window (done at every END_EARTHQUAKE event)
+void D7SClass::addToStatistics(const d7s_earthquake &earthquake) {
+   uint16_t si = toFixedPoint(earthquake.si);
+   uint16_t pga = toFixedPoint(earthquake.pga);
+   //the statistics are updated by the INT2 handler too
+   D7S_ENTER_CRITICAL(interruptState);
+   //update count (saturated) and sum
+   if (_statCount < 0xFFFF) {
+      _statCount++;
+      _statSumSI += si;
+   }
+   //update max values
+   if (si > _statMaxSI) {
+      _statMaxSI = si;
+   }
+   if (pga > _statMaxPGA) {
+      _statMaxPGA = pga;
+   }
+   D7S_EXIT_CRITICAL(interruptState);
+}
+
+//return the statistics of the current window
+d7s_statistics D7SClass::getStatistics() {
+   //take a snapshot (the statistics are updated by the INT2 handler)
+   D7S_ENTER_CRITICAL(interruptState);
+   uint16_t count = _statCount;
+   uint32_t sum = _statSumSI;
+   uint16_t maxSI = _statMaxSI;
+   uint16_t maxPGA = _statMaxPGA;
+   D7S_EXIT_CRITICAL(interruptState);
+
+   d7s_statistics statistics;
+   statistics.count = count;
+   statistics.maxSI = maxSI;
+   statistics.meanSI = count ? (uint16_t) ((sum + count / 2) / count) : 0;
+   statistics.maxPGA = maxPGA;
+   statistics.maxIntensity = jmaIntensity(maxSI);
+   return statistics;
+}
+
+//start a new window (e.g. every day)
+void D7SClass::resetStatistics() {
+   D7S_ENTER_CRITICAL(interruptState);
+   _statCount = 0;
+   _statSumSI = 0;
+   _statMaxSI = 0;
+   _statMaxPGA = 0;
+   D7S_EXIT_CRITICAL(interruptState);
+}
+
+//return the peak of the instantaneus PGA read during the current earthquake [m/s^2]
+float D7SClass::getPeakPGA() {
+   //16 bit read (it's reset by the INT2 handler)
+   D7S_ENTER_CRITICAL(interruptState);
+   uint16_t peak = _peakPGA;
+   D7S_EXIT_CRITICAL(interruptState);
+   return ((float) peak) / 1000;
+}
+
+//reset the peak of the instantaneus PGA (done at every START_EARTHQUAKE event)
+void D7SClass::resetPeakPGA() {
+   D7S_ENTER_CRITICAL(interruptState);
+   _peakPGA = 0;
+   D7S_EXIT_CRITICAL(interruptState);
+}
+
+//--- TELEMETRY FRAMES ---
+//set the node id written into each frame
+void D7SClass::setNodeId(uint16_t id) {
+   _nodeId = id;
+}
+
+//read the status of the D7S and encode it
+uint8_t D7SClass::encodeStatusFrame(uint8_t *frame) {
+   //read STATE (0x1000) and AXIS_STATE (0x1001) at once
+   uint8_t data[2] = {0, 0};
+   readRegister(0x10, 0x00, data, 2);
+   //encode the status (the bus status tells if the data is valid)
+   uint8_t payload[4];
+   payload[0] = data[0] & 0x07;
+   payload[1] = data[1] & 0x03;
+   payload[2] = _events;
+   payload[3] = _busStatus;
+   return encodeFrame(frame, D7S_FRAME_STATUS, payload, 4);
+}
+
+//encode the earthquake data
+uint8_t D7SClass::encodeEarthquakeFrame(uint8_t *frame, const d7s_earthquake &earthquake) {
+   //the temperature is signed (tenths of Celsius)
+   int16_t temperature = (int16_t) (earthquake.temperature * 10 + (earthquake.temperature < 0 ? -0.5 : 0.5));
+   uint16_t si = toFixedPoint(earthquake.si);
+   uint16_t pga = toFixedPoint(earthquake.pga);
+   //encode the data (big endian as the D7S registers)
+   uint8_t payload[6];
+   payload[0] = (uint16_t) temperature >> 8;
+   payload[1] = (uint16_t) temperature & 0xFF;
+   payload[2] = si >> 8;
+   payload[3] = si & 0xFF;
+   payload[4] = pga >> 8;
+   payload[5] = pga & 0xFF;
+   return encodeFrame(frame, D7S_FRAME_EARTHQUAKE, payload, 6);
+}
+
+//read the instantaneus SI and PGA and encode them
+uint8_t D7SClass::encodeSampleFrame(uint8_t *frame) {
+   //read instantaneus SI (0x2000) and PGA (0x2002) at once
+   uint8_t data[4];
+   if (!readRegister(0x20, 0x00, data, 4)) {
+      return 0;
+   }
+   //update the peak of the current earthquake
+   updatePeakPGA((data[2] << 8) | data[3]);
+   //encode the sample with its timestamp
+   uint32_t now = millis();
+   uint8_t payload[8];
+   payload[0] = now >> 24;
+   payload[1] = (now >> 16) & 0xFF;
+   payload[2] = (now >> 8) & 0xFF;
+   payload[3] = now & 0xFF;
+   memcpy(payload + 4, data, 4);
+   return encodeFrame(frame, D7S_FRAME_SAMPLE, payload, 8);
+}
+
+//encode the statistics of the current window
+uint8_t D7SClass::encodeStatisticsFrame(uint8_t *frame) {
+   d7s_statistics statistics = getStatistics();
+   //encode the statistics (big endian)
+   uint8_t payload[9];
+   payload[0] = statistics.count >> 8;
+   payload[1] = statistics.count & 0xFF;
+   payload[2] = statistics.maxSI >> 8;
+   payload[3] = statistics.maxSI & 0xFF;
+   payload[4] = statistics.meanSI >> 8;
+   payload[5] = statistics.meanSI & 0xFF;
+   payload[6] = statistics.maxPGA >> 8;
+   payload[7] = statistics.maxPGA & 0xFF;
+   payload[8] = statistics.maxIntensity;
+   return encodeFrame(frame, D7S_FRAME_STATISTICS, payload, 9);
+}
+
+//encode an interrupt event (without reading the D7S)
+uint8_t D7SClass::encodeEventFrame(uint8_t *frame, d7s_interrupt_event event) {
+   uint8_t payload[3];
+   payload[0] = event;
+   payload[1] = _events;
+   payload[2] = _earthquakeOccuring ? NORMAL_MODE_NOT_IN_STANBY : NORMAL_MODE;
+   return encodeFrame(frame, D7S_FRAME_EVENT, payload, 3);
 }
 
 //--- CLEAR MEMORY ---
@@ -200,27 +581,35 @@ void D7SClass::initialize() {
 //--- SELFTEST ---
 //start autodiagnostic and resturn the result (OK/ERROR)
 void D7SClass::selftest() {
+   //forget the previus result
+   _events &= ~0x04;
    //write SELFTEST command
    write8bit(0x10, 0x03, 0x04);
 }
 
 //return the result of self-diagnostic test (OK/ERROR)
 d7s_mode_status D7SClass::getSelftestResult() {
-   //return result of the selftest
-   return (d7s_mode_status) ((read8bit(0x10, 0x02) & 0x07) >> 2);
+   //updating the _events variable
+   readEvents();
+   //return result of the selftest (it's the third bit of _events)
+   return (d7s_mode_status) ((_events & 0x04) >> 2);
 }
 
 //--- OFFSET ACQUISITION ---
 //start offset acquisition and return the rersult (OK/ERROR)
 void D7SClass::acquireOffset() {
+   //forget the previus result
+   _events &= ~0x08;
    //write OFFSET ACQUISITION MODE command
    write8bit(0x10, 0x03, 0x03);
 }
 
 //return the result of offset acquisition test (OK/ERROR)
 d7s_mode_status D7SClass::getAcquireOffsetResult() {
-   //return result of the offset acquisition
-   return (d7s_mode_status) ((read8bit(0x10, 0x02) & 0x0F) >> 3);
+   //updating the _events variable
+   readEvents();
+   //return result of the offset acquisition (it's the fourth bit of _events)
+   return (d7s_mode_status) ((_events & 0x08) >> 3);
 }
 
 //--- SHUTOFF/COLLAPSE EVENT ---
@@ -258,7 +647,16 @@ uint8_t D7SClass::isEarthquakeOccuring() {
 
 //--- READY STATE ---
 uint8_t D7SClass::isReady() {
-   return getState() == NORMAL_MODE;
+   d7s_status state = getState();
+   //save the time to ready
+   updateReady(state);
+   //a failed read is not a ready state
+   return state == NORMAL_MODE && _busStatus == D7S_BUS_OK;
+}
+
+//return the time [ms] from the first begin() to the first ready state seen (0 if not ready yet)
+uint32_t D7SClass::getTimeToReady() {
+   return _readySeen ? _timeToReady : 0;
 }
 
 //--- INTERRUPT ---
@@ -274,12 +672,21 @@ void D7SClass::enableInterruptINT1(uint8_t pin) {
 void D7SClass::enableInterruptINT2(uint8_t pin) {
    //enable pull up resistor
    pinMode(pin, INPUT_PULLUP);
+   //save the pin (its level is used to validate the edges)
+   pinINT2 = pin;
+   _int2Attached = 1;
+   //the tracked state follows the level of INT2 (low while an earthquake is occuring or in installation/offset/selftest mode)
+   _earthquakeOccuring = 0;
+   _int2Mode = 0;
+   if (digitalRead(pin) == LOW) {
+      _earthquakeOccuring = confirmEarthquake();
+      _int2Mode = !_earthquakeOccuring;
+   }
    // Fishino32 cannot handle CHANGE mode on interrupts, so we need to register FALLING mode first and on the isr register
    // as RISING the same pin detaching the previus interrupt
    #if defined(_FISHINO_PIC32_) || defined(_FISHINO32_) || defined(_FISHINO32_120_) || defined(_FISHINO32_MX470F512H_) || defined(_FISHINO32_MX470F512H_120_)
-      pinINT2 = pin;
-      //attach interrupt
-      attachInterrupt(digitalPinToInterrupt(pin), isr2, FALLING);
+      //attach interrupt (RISING if INT2 is low)
+      attachInterrupt(digitalPinToInterrupt(pin), isr2, isINT2Low() ? RISING : FALLING);
    #else
       //attach interrupt
       attachInterrupt(digitalPinToInterrupt(pin), isr2, CHANGE);
@@ -288,8 +695,35 @@ void D7SClass::enableInterruptINT2(uint8_t pin) {
 
 //start interrupt handling
 void D7SClass::startInterruptHandling() {
+   //re-sync the tracked state with the level of INT2 (an edge may have been missed before)
+   //the missed edges are followed as the handler does (unless it's handling one), without dispatching them
+   if (_int2Attached) {
+      D7S_ENTER_CRITICAL(interruptState);
+      uint8_t busy = _int2Busy;
+      _int2Busy = 1;
+      D7S_EXIT_CRITICAL(interruptState);
+      if (!busy) {
+         uint8_t tracked = _earthquakeOccuring;
+         trackINT2(micros());
+         //an earthquake in progress is resumed, one already ended (or an installation/offset/selftest mode) is forgotten
+         if (_earthquakeOccuring && !tracked) {
+            _resumeEarthquake = 1;
+         } else if (!_earthquakeOccuring) {
+            _resumeEarthquake = 0;
+         }
+         _int2Busy = 0;
+      }
+   }
    //enabling interrupt handling
    _interruptEnabled = 1;
+   //resume the earthquake found by the warm start (or by the level of INT2)
+   if (_resumeEarthquake) {
+      _resumeEarthquake = 0;
+      resetPeakPGA();
+      uint32_t resolvedTime = micros();
+      dispatch(START_EARTHQUAKE, NULL); //START_EARTHQUAKE EVENT
+      journal(resolvedTime, resolvedTime, START_EARTHQUAKE, NORMAL_MODE_NOT_IN_STANBY, D7S_JOURNAL_LATE_TIMESTAMP);
+   }
 }
 
 //stop interrupt handling
@@ -299,239 +733,843 @@ void D7SClass::stopInterruptHandling() {
 }
 
 //assing the handler to the specific event
-void D7SClass::registerInterruptEventHandler(d7s_interrupt_event event, void (*handler) ()) {
-   //check if event is in bound (it's the index to the handlers array)
-   if (event < 0 || event > 3) {
-      return;
+uint8_t D7SClass::registerInterruptEventHandler(d7s_interrupt_event event, void (*handler) ()) {
+   //the table is read by the ISRs (dispatch), so the slot is replaced and filled at once
+   D7S_ENTER_CRITICAL(interruptState);
+   //remove the handler previusly assigned and get a free slot
+   d7s_handler_entry *entry = replaceLegacyHandler(event);
+   //save the handler (if there is room and the handler is not just removed)
+   if (entry && handler) {
+      entry->handler.simple = handler;
+      entry->context = NULL;
+      entry->kind = HANDLER_SIMPLE;
    }
-   //copy the pointer to the array
-   _handlers[event] = handler;
+   D7S_EXIT_CRITICAL(interruptState);
+   //false only if there is no room
+   return entry || !handler;
 }
 
-void D7SClass::registerInterruptEventHandler(d7s_interrupt_event event, void (*handler) (float, float, float)) {
-  registerInterruptEventHandler(event, (void (*)()) handler);
+//assing the handler to the END_EARTHQUAKE event
+uint8_t D7SClass::registerInterruptEventHandler(d7s_interrupt_event event, void (*handler) (float, float, float)) {
+   //only END_EARTHQUAKE event provides the earthquake data
+   if (event != END_EARTHQUAKE) {
+      return 0;
+   }
+   //the table is read by the ISRs (dispatch), so the slot is replaced and filled at once
+   D7S_ENTER_CRITICAL(interruptState);
+   //remove the handler previusly assigned and get a free slot
+   d7s_handler_entry *entry = replaceLegacyHandler(event);
+   //save the handler (if there is room and the handler is not just removed)
+   if (entry && handler) {
+      entry->handler.floats = handler;
+      entry->context = NULL;
+      entry->kind = HANDLER_FLOAT;
+   }
+   D7S_EXIT_CRITICAL(interruptState);
+   //false only if there is no room
+   return entry || !handler;
 }
 
+//add a handler with context to the specific event (return false if there is no room)
+uint8_t D7SClass::registerInterruptEventHandler(d7s_interrupt_event event, d7s_event_handler handler, void *context) {
+   //the handler is not valid
+   if (!handler) {
+      return 0;
+   }
+   //the table is read by the ISRs (dispatch), so the slot is taken and filled at once
+   D7S_ENTER_CRITICAL(interruptState);
+   //get a free slot
+   d7s_handler_entry *entry = allocateHandler(event);
+   //save the handler (if there is room)
+   if (entry) {
+      entry->handler.event = handler;
+      entry->context = context;
+      entry->kind = HANDLER_EVENT;
+   }
+   D7S_EXIT_CRITICAL(interruptState);
+   return entry != NULL;
+}
 
-//----------------------- PRIVATE INTERFACE -----------------------
+//add a handler with context to the END_EARTHQUAKE event (return false if there is no room)
+uint8_t D7SClass::registerInterruptEventHandler(d7s_interrupt_event event, d7s_earthquake_handler handler, void *context) {
+   //only END_EARTHQUAKE event provides the earthquake data
+   if (event != END_EARTHQUAKE) {
+      return 0;
+   }
+   //the handler is not valid
+   if (!handler) {
+      return 0;
+   }
+   //the table is read by the ISRs (dispatch), so the slot is taken and filled at once
+   D7S_ENTER_CRITICAL(interruptState);
+   //get a free slot
+   d7s_handler_entry *entry = allocateHandler(event);
+   //save the handler (if there is room)
+   if (entry) {
+      entry->handler.earthquake = handler;
+      entry->context = context;
+      entry->kind = HANDLER_EARTHQUAKE;
+   }
+   D7S_EXIT_CRITICAL(interruptState);
+   return entry != NULL;
+}
 
-//--- READ ---
-//read 8 bit from the specified register
-uint8_t D7SClass::read8bit(uint8_t regH, uint8_t regL) {
+//remove all the handlers of the specific event
+void D7SClass::unregisterInterruptEventHandlers(d7s_interrupt_event event) {
+   //the table is read by the ISRs (dispatch)
+   D7S_ENTER_CRITICAL(interruptState);
+   for (uint8_t i = 0; i < D7S_MAX_HANDLERS; i++) {
+      if (_handlers[i].event == event) {
+         _handlers[i].kind = HANDLER_NONE;
+      }
+   }
+   D7S_EXIT_CRITICAL(interruptState);
+}
+
+
+//--- EVENT JOURNAL ---
+//return the number of entries in the journal
+uint8_t D7SClass::getJournalCount() {
+   return _journalCount;
+}
+
+//read the entry at index (0 is the oldest) without removing it (return false if there is no entry)
+uint8_t D7SClass::peekJournal(uint8_t index, d7s_journal_entry &entry) {
+   uint8_t found = 0;
+   //the journal is written by the interrupt handlers
+   D7S_ENTER_CRITICAL(interruptState);
+   if (index < _journalCount) {
+      entry = _journal[(_journalHead + index) % D7S_JOURNAL_SIZE];
+      found = 1;
+   }
+   D7S_EXIT_CRITICAL(interruptState);
+   return found;
+}
+
+//read and remove the oldest entry (return false if the journal is empty)
+uint8_t D7SClass::readJournal(d7s_journal_entry &entry) {
+   uint8_t found = 0;
+   //the journal is written by the interrupt handlers
+   D7S_ENTER_CRITICAL(interruptState);
+   if (_journalCount > 0) {
+      entry = _journal[_journalHead];
+      _journalHead = (_journalHead + 1) % D7S_JOURNAL_SIZE;
+      _journalCount--;
+      found = 1;
+   }
+   D7S_EXIT_CRITICAL(interruptState);
+   return found;
+}
 
+//remove all the entries
+void D7SClass::clearJournal() {
+   D7S_ENTER_CRITICAL(interruptState);
+   _journalHead = 0;
+   _journalCount = 0;
+   _journalOverflow = 0;
+   D7S_EXIT_CRITICAL(interruptState);
+}
+
+//return how many entries have been overwritten because the journal was full
+uint16_t D7SClass::getJournalOverflowCount() {
+   //16 bit read (it's updated by the interrupt handlers)
+   D7S_ENTER_CRITICAL(interruptState);
+   uint16_t overflow = _journalOverflow;
+   D7S_EXIT_CRITICAL(interruptState);
+   return overflow;
+}
+
+//--- I2C BUS ---
+//set the max time [ms] spent recovering a stuck bus
+void D7SClass::setBusRecoveryTimeout(uint16_t timeout) {
+   _busRecoveryTimeout = timeout;
+}
+
+//return the status of the lastest transaction
+d7s_bus_status D7SClass::getBusStatus() {
+   return _busStatus;
+}
+
+//try to release a stuck bus (return true if the bus is free)
+//it clocks SCL up to nine times until the slave releases SDA, then it generates a STOP and restarts Wire
+//(where the lines cannot be driven as GPIO, see D7S_BUS_RECOVERY_CLOCKING, it only restarts Wire)
+//the whole recovery, re-sync included, is bounded by the recovery timeout
+uint8_t D7SClass::recoverBus() {
    //DEBUG
    #ifdef DEBUG
-      Serial.println("--- read8bit ---");
-      Serial.print("REG: 0x");
-      Serial.print(regH, HEX);
-      Serial.println(regL, HEX);
+      Serial.println("--- recoverBus ---");
    #endif
 
-   //setting up i2c connection
-   WireD7S.beginTransmission(D7S_ADDRESS);
-   
-   //write register address
-   WireD7S.write(regH); //register address high
-   delay(10); //delay to prevent freezing
-   WireD7S.write(regL); //register address low
-   delay(10); //delay to prevent freezing
-   
-   //send RE-START message
-   uint8_t status = WireD7S.endTransmission(false);
+   //recovery start time (used to bound the recovery time)
+   unsigned long start = millis();
 
-   //DEBUG
-   #ifdef DEBUG
-      Serial.print("[RE-START]: ");
-      //send RE-START message
-      Serial.println(status);
+   //the bus is considered released where the lines cannot be driven (only Wire is restarted)
+   uint8_t released = 1;
+
+   #if defined(D7S_BUS_RECOVERY_CLOCKING)
+   //release the pins from the TWI peripheral
+   #if defined(ARDUINO_ARCH_AVR)
+      WireD7S.end();
+   #endif
+   pinMode(D7S_SDA_PIN, INPUT_PULLUP);
+   pinMode(D7S_SCL_PIN, INPUT_PULLUP);
+
+   //clock SCL up to nine times until the slave releases SDA
+   for (uint8_t i = 0; i < 9 && digitalRead(D7S_SDA_PIN) == LOW; i++) {
+      //the slave may be stretching the clock
+      if (!waitSCL(start)) {
+         break;
+      }
+      //SCL low
+      digitalWrite(D7S_SCL_PIN, LOW);
+      pinMode(D7S_SCL_PIN, OUTPUT);
+      delayMicroseconds(5);
+      //SCL released (high)
+      pinMode(D7S_SCL_PIN, INPUT_PULLUP);
+      delayMicroseconds(5);
+   }
+
+   //generate a STOP condition (SDA rising while SCL is high)
+   if (waitSCL(start) && digitalRead(D7S_SDA_PIN) == HIGH) {
+      //SDA low
+      digitalWrite(D7S_SDA_PIN, LOW);
+      pinMode(D7S_SDA_PIN, OUTPUT);
+      delayMicroseconds(5);
+      //SDA released (high)
+      pinMode(D7S_SDA_PIN, INPUT_PULLUP);
+      delayMicroseconds(5);
+   }
+
+   //the bus is free if both the lines are high
+   released = digitalRead(D7S_SDA_PIN) == HIGH && digitalRead(D7S_SCL_PIN) == HIGH;
    #endif
 
-   //if the status != 0 there is an error
-   if (status != 0) {
-      //retry
-      return read8bit(regH, regL);
+   //restart Wire
+   beginWire();
+
+   //re-sync the tracked state reading STATE (0x1000), AXIS_STATE (0x1001) and EVENT (0x1002) at once
+   //(it also checks that the D7S is answering) with a single attempt, without delays, bounded by the recovery time
+   if (released && !_busRecovering) {
+      uint8_t data[3];
+      _busRecovering = 1;
+      released = readRegister(0x10, 0x00, data, 3, 0, 1, start + _busRecoveryTimeout);
+      //restore the timeout of the Wire transactions
+      setWireTimeout(D7S_I2C_TIMEOUT);
+      _busRecovering = 0;
+      if (released) {
+         //latch the events (the EVENT register is cleared by the read)
+         _events |= data[2] & 0x0F;
+         //without INT2 the earthquake in progress is tracked from STATE (with INT2 its level is tracked by the handler)
+         if (!_int2Attached) {
+            _earthquakeOccuring = (data[0] & 0x07) == NORMAL_MODE_NOT_IN_STANBY;
+         }
+      }
    }
 
-   //request 1 byte
-   WireD7S.requestFrom(D7S_ADDRESS, 1);
-   //wait until the data is received
-   while (WireD7S.available() < 1)
-      ;
-   //read the data
-   uint8_t data = WireD7S.read();
+   //update the bus state
+   if (released) {
+      _busRecoveryCount++;
+      _busStatus = D7S_BUS_OK;
+   } else {
+      _busStatus = D7S_BUS_STUCK;
+   }
 
    //DEBUG
    #ifdef DEBUG
-      Serial.println("--- read8bit ---");
+      Serial.print("[RECOVERED]: ");
+      Serial.println(released);
+      Serial.println("--- recoverBus ---");
    #endif
-  
+
+   return released;
+}
+
+//return how many transactions failed after all the retries
+uint16_t D7SClass::getBusErrorCount() {
+   return _busErrorCount;
+}
+
+//return how many times the bus has been found stuck
+uint16_t D7SClass::getBusStuckCount() {
+   return _busStuckCount;
+}
+
+//return how many times the bus has been recovered
+uint16_t D7SClass::getBusRecoveryCount() {
+   return _busRecoveryCount;
+}
+
+//reset the bus counters
+void D7SClass::resetBusCounters() {
+   _busErrorCount = 0;
+   _busStuckCount = 0;
+   _busRecoveryCount = 0;
+}
+
+
+//set the min time [us] INT2 must keep the new level to be a valid edge
+void D7SClass::setINT2MinPulseWidth(uint16_t width) {
+   _int2MinPulseWidth = width;
+}
+
+//return how many INT2 edges have been filtered (glitches or edges without a state transition)
+uint16_t D7SClass::getINT2FilteredCount() {
+   //the counter is updated by the INT2 handler
+   D7S_ENTER_CRITICAL(interruptState);
+   uint16_t count = _int2Filtered;
+   D7S_EXIT_CRITICAL(interruptState);
+   return count;
+}
+
+
+//----------------------- PRIVATE INTERFACE -----------------------
+
+//--- READ ---
+//read 8 bit from the specified register
+uint8_t D7SClass::read8bit(uint8_t regH, uint8_t regL) {
+   uint8_t data = 0;
+   //read the register (on error the data is 0)
+   readRegister(regH, regL, &data, 1);
    //return the data
    return data;
 }
 
 //read 16 bit from the specified register
 uint16_t D7SClass::read16bit(uint8_t regH, uint8_t regL) {
+   uint8_t data[2] = {0, 0};
+   //read the registers (on error the data is 0)
+   readRegister(regH, regL, data, 2);
+   //return the data
+   return (data[0] << 8) | data[1];
+}
+
+//read len bytes starting from the specified register (return true on success)
+//with a deadline [millis()] the whole read, Wire transactions included, gives up at the deadline
+//(otherwise each attempt waits up to D7S_I2C_TIMEOUT ms for the data)
+uint8_t D7SClass::readRegister(uint8_t regH, uint8_t regL, uint8_t *data, uint8_t len, uint8_t settle, uint8_t attempts, unsigned long deadline) {
 
    //DEBUG
    #ifdef DEBUG
-      Serial.println("--- read16bit ---");
+      Serial.println("--- readRegister ---");
       Serial.print("REG: 0x");
       Serial.print(regH, HEX);
       Serial.println(regL, HEX);
    #endif
 
-   //setting up i2c connection
-   WireD7S.beginTransmission(D7S_ADDRESS);
-   
-   //write register address
-   WireD7S.write(regH); //register address high
-   delay(10); //delay to prevent freezing
-   WireD7S.write(regL); //register address low
-   delay(10); //delay to prevent freezing
-   
-   //send RE-START message
-   uint8_t status = WireD7S.endTransmission(false);
-
-   //DEBUG
-   #ifdef DEBUG
-      Serial.print("[RE-START]: ");
-      //send RE-START message
-      Serial.println(status);
-   #endif
+   //a bounded number of attempts (a failed transaction must not hang the node)
+   uint8_t recovered = 0;
+   for (uint8_t attempt = 0; attempt < attempts; attempt++) {
+      //setting up i2c connection
+      WireD7S.beginTransmission(D7S_ADDRESS);
+
+      //write register address
+      WireD7S.write(regH); //register address high
+      if (settle) { delay(10); } //delay to prevent freezing (skipped by batched transactions)
+      WireD7S.write(regL); //register address low
+      if (settle) { delay(10); } //delay to prevent freezing (skipped by batched transactions)
+
+      //send RE-START message (within the time left before the deadline)
+      uint8_t status = deadline && !setWireDeadline(deadline) ? 5 : WireD7S.endTransmission(false);
+
+      //DEBUG
+      #ifdef DEBUG
+         Serial.print("[RE-START]: ");
+         //send RE-START message
+         Serial.println(status);
+      #endif
+
+      //if the status == 0 the register address has been sent
+      if (status == 0 && (!deadline || setWireDeadline(deadline))) {
+         //request len bytes
+         WireD7S.requestFrom((int) D7S_ADDRESS, (int) len);
+         //wait until the data is received (up to D7S_I2C_TIMEOUT ms or the deadline)
+         unsigned long start = millis();
+         while (WireD7S.available() < len && (deadline ? (long) (deadline - millis()) > 0 : millis() - start < D7S_I2C_TIMEOUT))
+            ;
+         //if all the data has been received
+         if (WireD7S.available() >= len) {
+            //read the data
+            for (uint8_t i = 0; i < len; i++) {
+               data[i] = WireD7S.read();
+            }
+
+            //DEBUG
+            #ifdef DEBUG
+               Serial.println("--- readRegister ---");
+            #endif
+
+            _busStatus = D7S_BUS_OK;
+            return 1;
+         }
+         //discard the partial data
+         while (WireD7S.available()) {
+            WireD7S.read();
+         }
+      }
 
-   //if the status != 0 there is an error
-   if (status != 0) {
-      //retry again
-      return read16bit(regH, regL);
+      //the transaction failed, check the bus before retrying
+      if (!checkBus(recovered)) {
+         break;
+      }
    }
 
-   //request 2 byte
-   WireD7S.requestFrom(D7S_ADDRESS, 2);
-   //wait until the data is received
-   while (WireD7S.available() < 2)
-      ;
-   //read the data
-   uint8_t msb = WireD7S.read();
-   uint8_t lsb = WireD7S.read();
-
    //DEBUG
    #ifdef DEBUG
-      Serial.println("--- read16bit ---");
+      Serial.println("[FAILED]");
+      Serial.println("--- readRegister ---");
    #endif
 
-   //return the data
-   return (msb << 8) | lsb;
+   //giving up
+   _busErrorCount++;
+   if (_busStatus != D7S_BUS_STUCK) {
+      _busStatus = D7S_BUS_ERROR;
+   }
+   return 0;
 }
 
 //--- WRITE ---
-//write 8 bit to the register specified
-void D7SClass::write8bit(uint8_t regH, uint8_t regL, uint8_t val) {
+//write 8 bit to the register specified (return true on success)
+uint8_t D7SClass::write8bit(uint8_t regH, uint8_t regL, uint8_t val, uint8_t settle) {
    //DEBUG
    #ifdef DEBUG
       Serial.println("--- write8bit ---");
    #endif
 
-   //setting up i2c connection
-   WireD7S.beginTransmission(D7S_ADDRESS);
-   
-   //write register address
-   WireD7S.write(regH); //register address high
-   delay(10); //delay to prevent freezing
-   WireD7S.write(regL); //register address low
-   delay(10); //delay to prevent freezing
-   
-   //write data
-   WireD7S.write(val);
-   delay(10); //delay to prevent freezing
-   //closing the connection (STOP message)
-   uint8_t status = WireD7S.endTransmission(true);
+   //a bounded number of attempts (a failed transaction must not hang the node)
+   uint8_t recovered = 0;
+   for (uint8_t attempt = 0; attempt < D7S_I2C_RETRIES; attempt++) {
+      //setting up i2c connection
+      WireD7S.beginTransmission(D7S_ADDRESS);
+
+      //write register address
+      WireD7S.write(regH); //register address high
+      if (settle) { delay(10); } //delay to prevent freezing (skipped by batched transactions)
+      WireD7S.write(regL); //register address low
+      if (settle) { delay(10); } //delay to prevent freezing (skipped by batched transactions)
+
+      //write data
+      WireD7S.write(val);
+      if (settle) { delay(10); } //delay to prevent freezing (skipped by batched transactions)
+      //closing the connection (STOP message)
+      uint8_t status = WireD7S.endTransmission(true);
+
+      //DEBUG
+      #ifdef DEBUG
+         Serial.print("[STOP]: ");
+         //closing the connection (STOP message)
+         Serial.println(status);
+      #endif
+
+      //if the status == 0 the data has been written
+      if (status == 0) {
+         //DEBUG
+         #ifdef DEBUG
+            Serial.println("--- write8bit ---");
+         #endif
+
+         _busStatus = D7S_BUS_OK;
+         return 1;
+      }
+
+      //the transaction failed, check the bus before retrying
+      if (!checkBus(recovered)) {
+         break;
+      }
+   }
 
    //DEBUG
    #ifdef DEBUG
-      Serial.print("[STOP]: ");
-      //closing the connection (STOP message)
-      Serial.println(status);
+      Serial.println("[FAILED]");
       Serial.println("--- write8bit ---");
    #endif
+
+   //giving up
+   _busErrorCount++;
+   if (_busStatus != D7S_BUS_STUCK) {
+      _busStatus = D7S_BUS_ERROR;
+   }
+   return 0;
+}
+
+//--- I2C BUS ---
+//(re)initialize Wire (timeout [ms] of the Wire transactions where supported)
+void D7SClass::beginWire(uint16_t timeout) {
+   //begin Wire
+   WireD7S.begin();
+   //prevent Wire from hanging on a stuck bus
+   setWireTimeout(timeout);
+}
+
+//set the timeout [ms] of the Wire transactions where supported
+void D7SClass::setWireTimeout(uint16_t timeout) {
+   //the timeout reset the TWI peripheral
+   #if defined(WIRE_HAS_TIMEOUT)
+      WireD7S.setWireTimeout(timeout * 1000UL, true);
+   #else
+      (void) timeout;
+   #endif
+}
+
+//bound the next Wire transaction by the deadline [ms] (return false if it is over)
+uint8_t D7SClass::setWireDeadline(unsigned long deadline) {
+   long left = (long) (deadline - millis());
+   if (left <= 0) {
+      return 0;
+   }
+   setWireTimeout(left > 0xFFFF ? 0xFFFF : (uint16_t) left);
+   return 1;
+}
+
+//check if the bus is stuck after a failed transaction and try to recover it once (return false if the transaction must give up)
+uint8_t D7SClass::checkBus(uint8_t &recovered) {
+   //the bus is stuck if a slave is holding SDA or SCL low while the bus should be idle
+   if (digitalRead(D7S_SDA_PIN) == HIGH && digitalRead(D7S_SCL_PIN) == HIGH) {
+      return 1;
+   }
+   _busStuckCount++;
+   //nested recovery are not allowed (the recovery itself is reading the D7S) and each transaction recovers the bus only once
+   if (_busRecovering || recovered) {
+      _busStatus = D7S_BUS_STUCK;
+      return 0;
+   }
+   recovered = 1;
+   return recoverBus();
+}
+
+//wait until SCL is released by the slaves (return false on timeout)
+uint8_t D7SClass::waitSCL(unsigned long start) {
+   //wait until the recovery time is over
+   while (digitalRead(D7S_SCL_PIN) == LOW) {
+      if (millis() - start >= _busRecoveryTimeout) {
+         return 0;
+      }
+   }
+   return 1;
+}
+
+//--- READ EARTHQUAKE ---
+//read the earthquake data stored at the specified register (0x30 - 0x39)
+d7s_earthquake D7SClass::readEarthquake(uint8_t regH) {
+   //read TEMPERATURE (0x--06), SI (0x--08) and PGA (0x--0A) at once
+   uint8_t data[6] = {0, 0, 0, 0, 0, 0};
+   readRegister(regH, 0x06, data, 6);
+   //convert the data
+   d7s_earthquake earthquake;
+   earthquake.temperature = (float) ((int16_t) ((data[0] << 8) | data[1])) / 10;
+   earthquake.si = ((float) (uint16_t) ((data[2] << 8) | data[3])) / 1000;
+   earthquake.pga = ((float) (uint16_t) ((data[4] << 8) | data[5])) / 1000;
+   return earthquake;
+}
+
+//--- STATISTICS ---
+//estimate the JMA seismic intensity from the SI [mm/s]
+d7s_jma_intensity D7SClass::jmaIntensity(uint16_t si) {
+   //count the classes whose lower bound is reached
+   uint8_t intensity = 0;
+   while (intensity < 9 && si >= JMA_SI_THRESHOLDS[intensity]) {
+      intensity++;
+   }
+   return (d7s_jma_intensity) intensity;
+}
+
+//update the peak of the instantaneus PGA of the current earthquake [mm/s^2]
+void D7SClass::updatePeakPGA(uint16_t pga) {
+   //read-modify-write (the peak is reset by the INT2 handler)
+   D7S_ENTER_CRITICAL(interruptState);
+   if (pga > _peakPGA) {
+      _peakPGA = pga;
+   }
+   D7S_EXIT_CRITICAL(interruptState);
+}
+
+//convert a value to thousandths (saturated to 16 bit)
+uint16_t D7SClass::toFixedPoint(float value) {
+   if (value <= 0) {
+      return 0;
+   }
+   if (value >= 65.535) {
+      return 0xFFFF;
+   }
+   return (uint16_t) (value * 1000 + 0.5);
+}
+
+//--- READY STATE ---
+//save the time to ready the first time the D7S is ready
+void D7SClass::updateReady(d7s_status state) {
+   if (!_readySeen && _busStatus == D7S_BUS_OK && (state == NORMAL_MODE || state == NORMAL_MODE_NOT_IN_STANBY)) {
+      _timeToReady = millis() - _beginTime;
+      _readySeen = 1;
+   }
+}
+
+//--- TELEMETRY FRAMES ---
+//write header, payload and CRC-8 into the frame (return the frame size)
+uint8_t D7SClass::encodeFrame(uint8_t *frame, uint8_t type, const uint8_t *payload, uint8_t len) {
+   //check if the frame fits into the buffer
+   if (D7S_FRAME_HEADER_SIZE + len + 1 > D7S_FRAME_MAX_SIZE) {
+      return 0;
+   }
+   //header
+   frame[0] = D7S_FRAME_SYNC;
+   frame[1] = type;
+   frame[2] = _nodeId >> 8;
+   frame[3] = _nodeId & 0xFF;
+   //the sequence number is shared by all the frames (they may be encoded by the handlers too)
+   D7S_ENTER_CRITICAL(interruptState);
+   frame[4] = _frameSequence++;
+   D7S_EXIT_CRITICAL(interruptState);
+   frame[5] = len;
+   //payload
+   memcpy(frame + D7S_FRAME_HEADER_SIZE, payload, len);
+   //CRC-8 (polynomial 0x07) of everything but the sync byte
+   uint8_t size = D7S_FRAME_HEADER_SIZE + len;
+   uint8_t crc = 0;
+   for (uint8_t i = 1; i < size; i++) {
+      crc ^= frame[i];
+      for (uint8_t bit = 0; bit < 8; bit++) {
+         crc = (crc & 0x80) ? (crc << 1) ^ 0x07 : crc << 1;
+      }
+   }
+   frame[size] = crc;
+   return size + 1;
 }
 
 //--- READ EVENTS ---
-//read the event (SHUTOFF/COLLAPSE) from the EVENT register
+//read the event (SHUTOFF/COLLAPSE/SELFTEST ERROR/OFFSET ERROR) from the EVENT register
 void D7SClass::readEvents() {
-   //read the EVENT register at 0x1002 and obtaining only the first two bits
-   uint8_t events = read8bit(0x10, 0x02) & 0x03;
+   //read the EVENT register at 0x1002 and obtaining only the first four bits
+   uint8_t events = read8bit(0x10, 0x02) & 0x0F;
    //updating the _events variable
    _events |= events;
 }
 
 //--- INTERRUPT HANDLER ---
-//handle the INT1 events
-void D7SClass::int1() {
+//handle the INT1 events (edgeTime is micros() at the edge)
+void D7SClass::int1(uint32_t edgeTime) {
    //enabling interrupts
    interrupts();
    //if the interrupt handling is enabled
    if (_interruptEnabled) {
       //check what event triggered the interrupt
-      if (isInShutoff()) {
-         //if the handler is defined
-         if (_handlers[2]) {
-            _handlers[2](); //SHUTOFF_EVENT EVENT
-         }
-      } else {
-         //if the handler is defined
-         if (_handlers[3]) {
-            _handlers[3](); //COLLAPSE_EVENT EVENT
-         }
-      }
+      d7s_interrupt_event event = isInShutoff() ? SHUTOFF_EVENT : COLLAPSE_EVENT;
+      uint32_t resolvedTime = micros();
+      dispatch(event, NULL); //SHUTOFF_EVENT/COLLAPSE_EVENT EVENT
+      //the state is not read to keep the I2C traffic low (it's tracked on INT2)
+      journal(edgeTime, resolvedTime, event, _earthquakeOccuring ? NORMAL_MODE_NOT_IN_STANBY : NORMAL_MODE);
    }
 }
 
-//handle the INT2 events
-void D7SClass::int2() {
+//handle the INT2 events (edgeTime is micros() at the edge)
+//INT2 is low while an earthquake is occuring, so its level tells the transition without reading the state
+//the level is tracked even when the interrupt handling is stopped (only the dispatch is skipped)
+void D7SClass::int2(uint32_t edgeTime) {
+   //the edges occured while another one is handled are checked by it before returning
+   //(checked and set before enabling interrupts, so a nested edge cannot slip in between)
+   if (_int2Busy) {
+      return;
+   }
+   _int2Busy = 1;
    //enabling interrupts
    interrupts();
-   //if the interrupt handling is enabled
-   if (_interruptEnabled) {
-      //check what in what state the D7S is
-      if (isEarthquakeOccuring()) { //earthquake started
-         // Fishino32 cannot handle CHANGE mode on interrupts, so we need to register FALLING mode first and on the isr register
-         // as RISING the same pin detaching the previus interrupt
-         #if defined(_FISHINO_PIC32_) || defined(_FISHINO32_) || defined(_FISHINO32_120_) || defined(_FISHINO32_MX470F512H_) || defined(_FISHINO32_MX470F512H_120_)
-            // Detaching the previus interrupt as FALLING
-            detachInterrupt(digitalPinToInterrupt(pinINT2));
-            // Attaching the same interrupt as RISING
-            attachInterrupt(digitalPinToInterrupt(pinINT2), isr2, RISING);
-         #endif
-         //if the handler is defined
-         if (_handlers[0]) {
-            _handlers[0](); //START_EARTHQUAKE EVENT
-         }
-      } else { //earthquake ended
-         // Fishino32 cannot handle CHANGE mode on interrupts, so we need to register FALLING mode first and on the isr register
-         // as RISING the same pin detaching the previus interrupt
-         #if defined(_FISHINO_PIC32_) || defined(_FISHINO32_) || defined(_FISHINO32_120_) || defined(_FISHINO32_MX470F512H_) || defined(_FISHINO32_MX470F512H_120_)
-            // Detaching the previus interrupt as FALLING
-            detachInterrupt(digitalPinToInterrupt(pinINT2));
-            // Attaching the same interrupt as RISING
-            attachInterrupt(digitalPinToInterrupt(pinINT2), isr2, FALLING);
-         #endif
-         //if the handler is defined
-         if (_handlers[1]) {
-            ((void (*)(float, float, float)) _handlers[1])(getLastestSI(0), getLastestPGA(0), getLastestTemperature(0)); //END_EARTHQUAKE EVENT
+
+   //no transition: a glitch or a duplicated edge
+   if (!trackINT2(edgeTime)) {
+      _int2Filtered++;
+   }
+
+   _int2Busy = 0;
+}
+
+//follow the transitions of INT2 until it agrees with the tracked state (return how many)
+//the events are dispatched only if the interrupt handling is enabled
+uint8_t D7SClass::trackINT2(uint32_t edgeTime) {
+   uint8_t transitions = 0;
+   while (1) {
+      //wait until INT2 is stable
+      uint8_t level = debounceINT2();
+      //INT2 agrees with the tracked state
+      if (level == (isINT2Low() ? LOW : HIGH)) {
+         break;
+      }
+
+      //update the tracked state (an earthquake ends only if it has been tracked as an earthquake)
+      uint8_t ended = level == HIGH && _earthquakeOccuring;
+      if (level == LOW) {
+         //INT2 is low in installation/offset/selftest mode too
+         _earthquakeOccuring = confirmEarthquake();
+         _int2Mode = !_earthquakeOccuring;
+      } else {
+         _earthquakeOccuring = 0;
+         _int2Mode = 0;
+      }
+      // Fishino32 cannot handle CHANGE mode on interrupts, so we need to register FALLING mode first and on the isr register
+      // as RISING the same pin detaching the previus interrupt
+      armINT2();
+
+      //if the interrupt handling is enabled
+      if (_interruptEnabled) {
+         //the edges missed while handling the previus one are timestamped late
+         uint8_t flags = transitions ? D7S_JOURNAL_LATE_TIMESTAMP : 0;
+         if (_earthquakeOccuring) { //earthquake started
+            //a new earthquake starts a new peak
+            resetPeakPGA();
+            uint32_t resolvedTime = micros();
+            dispatch(START_EARTHQUAKE, NULL); //START_EARTHQUAKE EVENT
+            journal(edgeTime, resolvedTime, START_EARTHQUAKE, NORMAL_MODE_NOT_IN_STANBY, flags);
+         } else if (ended) { //earthquake ended
+            //read the earthquake data once for the statistics and all the handlers
+            d7s_earthquake earthquake = readEarthquake(0x30);
+            addToStatistics(earthquake);
+            uint32_t resolvedTime = micros();
+            dispatch(END_EARTHQUAKE, &earthquake); //END_EARTHQUAKE EVENT
+            journal(edgeTime, resolvedTime, END_EARTHQUAKE, NORMAL_MODE, flags);
          }
       }
+
+      //an edge missed while handling this one can only be timestamped now
+      edgeTime = micros();
+      transitions++;
+   }
+   return transitions;
+}
+
+//confirm on STATE the earthquake signaled by a low INT2 (it's low in installation/offset/selftest mode too)
+//a single read without delays, on a bus error the earthquake is taken as confirmed
+uint8_t D7SClass::confirmEarthquake() {
+   uint8_t state;
+   if (!readRegister(0x10, 0x00, &state, 1, 0)) {
+      return 1;
+   }
+   return (state & 0x07) == NORMAL_MODE_NOT_IN_STANBY;
+}
+
+//return true if the tracked level of INT2 is low
+uint8_t D7SClass::isINT2Low() {
+   return _earthquakeOccuring || _int2Mode;
+}
+
+//arm INT2 for the next edge (Fishino32 only: it cannot handle CHANGE mode on interrupts)
+void D7SClass::armINT2() {
+   #if defined(_FISHINO_PIC32_) || defined(_FISHINO32_) || defined(_FISHINO32_120_) || defined(_FISHINO32_MX470F512H_) || defined(_FISHINO32_MX470F512H_120_)
+      // Detaching the previus interrupt
+      detachInterrupt(digitalPinToInterrupt(pinINT2));
+      // Attaching the same interrupt as RISING during an earthquake (end edge) or FALLING otherwise (start edge)
+      attachInterrupt(digitalPinToInterrupt(pinINT2), isr2, isINT2Low() ? RISING : FALLING);
+   #endif
+}
+
+//--- INT2 EDGE FILTER ---
+//wait until INT2 keeps the same level for the min pulse width and return it
+//the wait is bounded to 8 times the min pulse width (a noisy line returns the lastest level)
+uint8_t D7SClass::debounceINT2() {
+   uint32_t start = micros();
+   uint32_t since = start;
+   uint8_t level = digitalRead(pinINT2);
+   while (micros() - since < _int2MinPulseWidth && micros() - start < 8UL * _int2MinPulseWidth) {
+      uint8_t now = digitalRead(pinINT2);
+      //the level changed: restart the pulse
+      if (now != level) {
+         level = now;
+         since = micros();
+      }
+   }
+   return level;
+}
+
+//--- EVENT JOURNAL ---
+//add an entry to the journal (the dispatch ends now)
+void D7SClass::journal(uint32_t edgeTime, uint32_t resolvedTime, d7s_interrupt_event event, d7s_status state, uint8_t flags) {
+   uint32_t dispatchedTime = micros();
+   //the interrupt handlers run with interrupts enabled, so INT1 and INT2 may be nested
+   D7S_ENTER_CRITICAL(interruptState);
+   //if the journal is full the oldest entry is overwritten
+   if (_journalCount == D7S_JOURNAL_SIZE) {
+      _journalHead = (_journalHead + 1) % D7S_JOURNAL_SIZE;
+      _journalCount--;
+      _journalOverflow++;
+   }
+   d7s_journal_entry &entry = _journal[(_journalHead + _journalCount) % D7S_JOURNAL_SIZE];
+   entry.timestamp = edgeTime;
+   entry.resolveTime = resolvedTime - edgeTime;
+   entry.dispatchTime = dispatchedTime - resolvedTime;
+   entry.event = event;
+   entry.state = state;
+   entry.events = _events & 0x03;
+   entry.flags = flags;
+   _journalCount++;
+   D7S_EXIT_CRITICAL(interruptState);
+}
+
+//--- HANDLERS ---
+//return a free slot of the handler table (NULL if there is no room), to be called in a critical section
+D7SClass::d7s_handler_entry *D7SClass::allocateHandler(d7s_interrupt_event event) {
+   //check if event is in bound
+   if (event < 0 || event > 3) {
+      return NULL;
+   }
+   //search a free slot
+   for (uint8_t i = 0; i < D7S_MAX_HANDLERS; i++) {
+      if (_handlers[i].kind == HANDLER_NONE) {
+         _handlers[i].event = event;
+         return &_handlers[i];
+      }
+   }
+   return NULL;
+}
+
+//remove the handler assigned with the old interface and return a free slot (NULL if there is no room), to be called in a critical section
+D7SClass::d7s_handler_entry *D7SClass::replaceLegacyHandler(d7s_interrupt_event event) {
+   //remove the handler previusly assigned
+   for (uint8_t i = 0; i < D7S_MAX_HANDLERS; i++) {
+      if (_handlers[i].event == event && (_handlers[i].kind == HANDLER_SIMPLE || _handlers[i].kind == HANDLER_FLOAT)) {
+         _handlers[i].kind = HANDLER_NONE;
+      }
+   }
+   //get a free slot
+   return allocateHandler(event);
+}
+
+//call all the handlers of the event (earthquake is provided only with END_EARTHQUAKE event)
+void D7SClass::dispatch(d7s_interrupt_event event, const d7s_earthquake *earthquake) {
+   for (uint8_t i = 0; i < D7S_MAX_HANDLERS; i++) {
+      d7s_handler_entry &entry = _handlers[i];
+      //skip the handlers of the other events
+      if (entry.kind == HANDLER_NONE || entry.event != event) {
+         continue;
+      }
+      //call the handler with its signature
+      switch (entry.kind) {
+         case HANDLER_SIMPLE:
+            entry.handler.simple();
+            break;
+         case HANDLER_FLOAT:
+            if (earthquake) {
+               entry.handler.floats(earthquake->si, earthquake->pga, earthquake->temperature);
+            }
+            break;
+         case HANDLER_EVENT:
+            entry.handler.event(entry.context);
+            break;
+         case HANDLER_EARTHQUAKE:
+            if (earthquake) {
+               entry.handler.earthquake(*earthquake, entry.context);
+            }
+            break;
+      }
    }
 }
 
 //--- ISR HANDLER ---
 //it handle the FALLING event that occur to the INT1 D7S pin (glue routine)
 void D7SClass::isr1() {
-   D7S.int1();
+   //the timestamp is taken before any I2C read
+   D7S.int1(micros());
 }
 
 //it handle the CHANGE event thant occur to the INT2 D7S pin (glue routine)
 void D7SClass::isr2() {
-   D7S.int2();
+   //the timestamp is taken before any I2C read
+   D7S.int2(micros());
 }
 
 //extern object
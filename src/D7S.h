@@ -35,9 +35,92 @@
    #define WireD7S Wire
 #endif
 
+//--- CRITICAL SECTIONS ---
+//save the interrupt state and disable interrupts, then restore the state saved (interrupts stay disabled if they were)
+#if defined(ARDUINO_ARCH_AVR)
+   #define D7S_ENTER_CRITICAL(state) uint8_t state = SREG; cli()
+   #define D7S_EXIT_CRITICAL(state) SREG = state
+#elif defined(ESP8266)
+   #define D7S_ENTER_CRITICAL(state) uint32_t state = xt_rsil(15)
+   #define D7S_EXIT_CRITICAL(state) xt_wsr_ps(state)
+#elif defined(__PIC32MX__) || defined(__PIC32MZ__) || defined(_FISHINO_PIC32_) || defined(_FISHINO32_) || defined(_FISHINO32_120_) || defined(_FISHINO32_MX470F512H_) || defined(_FISHINO32_MX470F512H_120_)
+   #define D7S_ENTER_CRITICAL(state) uint32_t state = disableInterrupts()
+   #define D7S_EXIT_CRITICAL(state) restoreInterrupts(state)
+#else
+   //the interrupt state cannot be saved: interrupts are enabled at the end
+   #define D7S_ENTER_CRITICAL(state) noInterrupts()
+   #define D7S_EXIT_CRITICAL(state) interrupts()
+#endif
+
 //--- ADDRESS ---
 #define D7S_ADDRESS 0x55 //D7S address on the I2C bus
 
+//--- I2C BUS ---
+#define D7S_I2C_RETRIES 3 //number of attempts of each transaction before giving up
+#define D7S_I2C_TIMEOUT 25 //max time [ms] to wait for the data requested to the D7S
+#define D7S_BUS_RECOVERY_TIMEOUT 50 //default max time [ms] spent recovering a stuck bus (re-sync included)
+
+//the lines can be driven as GPIO only where the I2C peripheral releases them (AVR with Wire.end(), ESP8266 bit-banged Wire)
+//on the other cores (e.g. Fishino32) the recovery just restarts Wire and re-syncs the sensor
+#if defined(ARDUINO_ARCH_AVR) || defined(ESP8266)
+   #define D7S_BUS_RECOVERY_CLOCKING
+#endif
+
+//pins used to recover a stuck bus (they can be defined before including D7S.h to override them)
+#ifndef D7S_SDA_PIN
+   #if defined(_FISHINO_PIC32_) || defined(_FISHINO32_) || defined(_FISHINO32_120_) || defined(_FISHINO32_MX470F512H_) || defined(_FISHINO32_MX470F512H_120_)
+      #define D7S_SDA_PIN __DTWI0_SDA_PIN
+   #else
+      #define D7S_SDA_PIN SDA
+   #endif
+#endif
+#ifndef D7S_SCL_PIN
+   #if defined(_FISHINO_PIC32_) || defined(_FISHINO32_) || defined(_FISHINO32_120_) || defined(_FISHINO32_MX470F512H_) || defined(_FISHINO32_MX470F512H_120_)
+      #define D7S_SCL_PIN __DTWI0_SCL_PIN
+   #else
+      #define D7S_SCL_PIN SCL
+   #endif
+#endif
+
+//--- EVENT HANDLERS ---
+#define D7S_MAX_HANDLERS 8 //max number of event handlers registered at the same time (for all the events)
+
+//--- WARM START ---
+#define D7S_WARM_START_TIMEOUT 10000 //default max time [ms] waiting for the D7S to leave the installation/offset/selftest modes
+
+//--- INT2 EDGE FILTER ---
+#define D7S_INT2_MIN_PULSE_WIDTH 500 //default min time [us] INT2 must keep the new level to be a valid edge
+
+//--- EVENT JOURNAL ---
+#define D7S_JOURNAL_SIZE 8 //number of entries of the event journal (the oldest entry is overwritten when full)
+#define D7S_JOURNAL_LATE_TIMESTAMP 0x01 //journal entry flag: the edge occured while another one was handled (or before the interrupt handling started), so the timestamp has been taken later
+
+//--- TELEMETRY FRAMES ---
+#define D7S_FRAME_SYNC 0xD7 //first byte of each frame
+#define D7S_FRAME_HEADER_SIZE 6 //sync, type, node id (2 bytes), sequence, payload length
+#define D7S_FRAME_MAX_SIZE 16 //max size of a frame (header, payload and CRC-8)
+
+//frame types
+#define D7S_FRAME_STATUS 0x01 //state, axis in use, event bits, bus status (4 bytes)
+#define D7S_FRAME_EARTHQUAKE 0x02 //temperature [0.1 Celsius], SI [mm/s], PGA [mm/s^2] (6 bytes)
+#define D7S_FRAME_SAMPLE 0x03 //millis() [ms], instantaneus SI [mm/s], instantaneus PGA [mm/s^2] (8 bytes)
+#define D7S_FRAME_STATISTICS 0x04 //count, max SI [mm/s], mean SI [mm/s], max PGA [mm/s^2], max JMA intensity (9 bytes)
+#define D7S_FRAME_EVENT 0x05 //interrupt event, event bits, tracked state (3 bytes)
+
+//--- CONFIGURATION ---
+//data to delete (clear mask of D7SConfig)
+#define D7S_CLEAR_EARTHQUAKE 0x01 //lastest data and ranked data
+#define D7S_CLEAR_SELFTEST 0x02 //selftest data
+#define D7S_CLEAR_OFFSET 0x04 //offset data
+#define D7S_CLEAR_INSTALLATION 0x08 //installation data
+#define D7S_CLEAR_ALL 0x0F //all data
+
+//result of D7SConfig::apply() (mismatches found by the readback)
+#define D7S_CONFIG_OK 0x00 //configuration applied
+#define D7S_CONFIG_AXIS_MISMATCH 0x01 //axis selection mode not applied
+#define D7S_CONFIG_THRESHOLD_MISMATCH 0x02 //threshold not applied
+#define D7S_CONFIG_BUS_ERROR 0x04 //a transaction failed
+
 //--- DEBUG ----
 //comment this line to disable all debug information
 //#define DEBUG
@@ -50,7 +133,7 @@ typedef enum d7s_status {
    INITIAL_INSTALLATION_MODE = 0x02,
    OFFSET_ACQUISITION_MODE = 0x03,
    SELFTEST_MODE = 0x04
-};
+} d7s_status;
 
 //d7s axis settings
 typedef enum d7s_axis_settings {
@@ -59,26 +142,41 @@ typedef enum d7s_axis_settings {
    FORXE_XY = 0x02,
    AUTO_SWITCH = 0x03,
    SWITCH_AT_INSTALLATION = 0x04 
-};
+} d7s_axis_settings;
 
 //axis state
 typedef enum d7s_axis_state {
    AXIS_YZ = 0x00,
    AXIS_XZ = 0x01,
    AXIS_XY = 0x02
-};
+} d7s_axis_state;
 
 //d7s threshold settings
 typedef enum d7s_threshold {
    THRESHOLD_HIGH = 0x00,
    THRESHOLD_LOW = 0x01
-};
+} d7s_threshold;
 
 //message status (selftes, offset acquisition)
 typedef enum d7s_mode_status {
    D7S_OK = 0,
    D7S_ERROR = 1
-};
+} d7s_mode_status;
+
+//result of the warm start
+typedef enum d7s_warm_start {
+   WARM_START_READY = 0, //the D7S is installed and in NORMAL MODE
+   WARM_START_EARTHQUAKE = 1, //an earthquake is in progress (it's resumed when the interrupt handling starts)
+   WARM_START_BUSY = 2, //the D7S is still in installation/offset/selftest mode after the timeout
+   WARM_START_ERROR = 3 //the D7S is not answering after the timeout
+} d7s_warm_start;
+
+//i2c bus status (of the lastest transaction)
+typedef enum d7s_bus_status {
+   D7S_BUS_OK = 0,
+   D7S_BUS_ERROR = 1, //the transaction failed after all the retries
+   D7S_BUS_STUCK = 2 //a slave is holding the bus low and it could not be recovered
+} d7s_bus_status;
 
 //events handled externaly by the using using an handler (the d7s int1, int2 must be connected to interrupt pin)
 typedef enum d7s_interrupt_event {
@@ -86,8 +184,83 @@ typedef enum d7s_interrupt_event {
    END_EARTHQUAKE = 1, //INT 2
    SHUTOFF_EVENT = 2, //INT 1
    COLLAPSE_EVENT = 3 //INT 1
+} d7s_interrupt_event;
+
+//earthquake data (a record of the lastest/ranked data)
+struct d7s_earthquake {
+   float si; //[m/s]
+   float pga; //[m/s^2]
+   float temperature; //[Celsius]
+};
+
+//JMA seismic intensity scale (estimated from the SI value)
+typedef enum d7s_jma_intensity {
+   JMA_0 = 0,
+   JMA_1 = 1,
+   JMA_2 = 2,
+   JMA_3 = 3,
+   JMA_4 = 4,
+   JMA_5_LOWER = 5,
+   JMA_5_UPPER = 6,
+   JMA_6_LOWER = 7,
+   JMA_6_UPPER = 8,
+   JMA_7 = 9
+} d7s_jma_intensity;
+
+//earthquake statistics of the current window (fixed point)
+struct d7s_statistics {
+   uint16_t count; //earthquakes occured in the window
+   uint16_t maxSI; //[mm/s]
+   uint16_t meanSI; //[mm/s]
+   uint16_t maxPGA; //[mm/s^2]
+   uint8_t maxIntensity; //JMA intensity of maxSI (d7s_jma_intensity)
+};
+
+//entry of the event journal (captured at interrupt time)
+struct d7s_journal_entry {
+   uint32_t timestamp; //micros() at the INT1/INT2 edge [us]
+   uint32_t resolveTime; //time from the edge to the event resolved (I2C reads included) [us]
+   uint32_t dispatchTime; //time spent by the handlers [us]
+   uint8_t event; //event occured (d7s_interrupt_event)
+   uint8_t state; //state of the D7S (d7s_status)
+   uint8_t events; //event bits (first bit => SHUTOFF, second bit => COLLAPSE)
+   uint8_t flags; //D7S_JOURNAL_LATE_TIMESTAMP if the timestamp is not taken at the edge
 };
 
+//event handlers with a user defined context
+typedef void (*d7s_event_handler) (void *context); //handler of any event
+typedef void (*d7s_earthquake_handler) (const d7s_earthquake &earthquake, void *context); //handler of the END_EARTHQUAKE event
+
+
+//desired configuration of the D7S applied at once (only the settings specified are applied)
+class D7SConfig {
+
+   public:
+
+      //--- CONSTRUCTOR ---
+      D7SConfig(); //empty configuration
+
+      //--- SETTINGS ---
+      D7SConfig &setAxis(d7s_axis_settings axisMode); //set the axis selection mode
+      D7SConfig &setThreshold(d7s_threshold threshold); //set the threshold
+      D7SConfig &clear(uint8_t clearMask); //delete the specified data (D7S_CLEAR_*)
+      D7SConfig &initialize(); //start the initial installation mode after the settings
+
+      //--- APPLY ---
+      uint8_t apply(); //apply the configuration to the D7S (return D7S_CONFIG_OK or the mismatches found)
+
+   private:
+      friend class D7SClass;
+
+      //settings specified (bit 0 => axis, bit 1 => threshold)
+      uint8_t _fields;
+      //desired settings
+      uint8_t _axis;
+      uint8_t _threshold;
+      uint8_t _clearMask;
+      uint8_t _initialize;
+
+};
 
 //class D7S
 class D7SClass {
@@ -99,6 +272,7 @@ class D7SClass {
 
       //--- BEGIN ---
       void begin(); //used to initialize Wire
+      d7s_warm_start warmStart(uint16_t timeout = D7S_WARM_START_TIMEOUT); //initialize Wire and resume the D7S in the state it is (without installation)
 
       //--- STATUS ---
       d7s_status getState(); //return the currect state
@@ -108,20 +282,43 @@ class D7SClass {
       void setThreshold(d7s_threshold threshold); //change the threshold in use
       void setAxis(d7s_axis_settings axisMode); //change the axis selection mode
 
+      //--- CONFIGURATION ---
+      uint8_t applyConfig(const D7SConfig &config); //apply the configuration with the minimum writes and verify it (return D7S_CONFIG_OK or the mismatches found)
+
       //--- LASTEST DATA ---
       float getLastestSI(uint8_t index); //get the lastest SI at specified index (up to 5) [m/s]
       float getLastestPGA(uint8_t index); //get the lastest PGA at specified index (up to 5) [m/s^2]
       float getLastestTemperature(uint8_t index); //get the lastest Temperature at specified index (up to 5) [Celsius]
+      d7s_earthquake getLastestEarthquake(uint8_t index); //get the lastest earthquake data at specified index (up to 5)
 
       //--- RANKED DATA ---
       float getRankedSI(uint8_t position); //get the ranked SI at specified position (up to 5) [m/s]
       float getRankedPGA(uint8_t position); //get the ranked PGA at specified position (up to 5) [m/s^2]
       float getRankedTemperature(uint8_t position); //get the ranked Temperature at specified position (up to 5) [Celsius]
+      d7s_earthquake getRankedEarthquake(uint8_t position); //get the ranked earthquake data at specified position (up to 5)
 
       //--- INSTANTANEUS DATA ---
       float getInstantaneusSI(); //get instantaneus SI (during an earthquake) [m/s]
       float getInstantaneusPGA(); //get instantaneus PGA (during an earthquake) [m/s^2]
 
+      //--- STATISTICS ---
+      d7s_jma_intensity getJMAIntensity(float si); //estimate the JMA seismic intensity from the SI [m/s]
+      void addToStatistics(const d7s_earthquake &earthquake); //add an earthquake to the statistics of the current window (done at every END_EARTHQUAKE event)
+      d7s_statistics getStatistics(); //return the statistics of the current window
+      void resetStatistics(); //start a new window (e.g. every day)
+      float getPeakPGA(); //return the peak of the instantaneus PGA read during the current earthquake [m/s^2]
+      void resetPeakPGA(); //reset the peak of the instantaneus PGA (done at every START_EARTHQUAKE event)
+
+      //--- TELEMETRY FRAMES ---
+      //the frames are written into a buffer of at least D7S_FRAME_MAX_SIZE bytes and the frame size is returned (0 on error)
+      //the encoders that read the D7S must not run while the interrupt handlers may use the bus (Wire is not reentrant)
+      void setNodeId(uint16_t id); //set the node id written into each frame
+      uint8_t encodeStatusFrame(uint8_t *frame); //read the status of the D7S and encode it
+      uint8_t encodeEarthquakeFrame(uint8_t *frame, const d7s_earthquake &earthquake); //encode the earthquake data
+      uint8_t encodeSampleFrame(uint8_t *frame); //read the instantaneus SI and PGA and encode them
+      uint8_t encodeStatisticsFrame(uint8_t *frame); //encode the statistics of the current window
+      uint8_t encodeEventFrame(uint8_t *frame, d7s_interrupt_event event); //encode an interrupt event (without reading the D7S)
+
       //--- CLEAR MEMORY ---
       void clearEarthquakeData(); //delete both the lastest data and the ranked data
       void clearInstallationData(); //delete initializzazion data
@@ -151,48 +348,170 @@ class D7SClass {
 
       //--- READY STATE ---
       uint8_t isReady();
+      uint32_t getTimeToReady(); //return the time [ms] from the first begin() to the first ready state seen (0 if not ready yet)
 
       //--- INTERRUPT ---
       void enableInterruptINT1(uint8_t pin); //enable interrupt INT1 on specified pin
       void enableInterruptINT2(uint8_t pin); //enable interrupt INT2 on specified pin
       void startInterruptHandling(); //start interrupt handling
       void stopInterruptHandling(); //stop interrupt handling
-      void registerInterruptEventHandler(d7s_interrupt_event event, void (*handler) ()); //assing the handler to the specific event
-      void registerInterruptEventHandler(d7s_interrupt_event event, void (*handler) (float, float, float)); //assing the handler to the specific event
+      uint8_t registerInterruptEventHandler(d7s_interrupt_event event, void (*handler) ()); //assing the handler to the specific event
+      uint8_t registerInterruptEventHandler(d7s_interrupt_event event, void (*handler) (float, float, float)); //assing the handler to the END_EARTHQUAKE event
+      uint8_t registerInterruptEventHandler(d7s_interrupt_event event, d7s_event_handler handler, void *context = NULL); //add a handler with context to the specific event (return false if there is no room)
+      uint8_t registerInterruptEventHandler(d7s_interrupt_event event, d7s_earthquake_handler handler, void *context = NULL); //add a handler with context to the END_EARTHQUAKE event (return false if there is no room)
+      void unregisterInterruptEventHandlers(d7s_interrupt_event event); //remove all the handlers of the specific event
+      void setINT2MinPulseWidth(uint16_t width); //set the min time [us] INT2 must keep the new level to be a valid edge
+      uint16_t getINT2FilteredCount(); //return how many INT2 edges have been filtered (glitches or edges without a state transition)
+
+      //--- EVENT JOURNAL ---
+      uint8_t getJournalCount(); //return the number of entries in the journal
+      uint8_t peekJournal(uint8_t index, d7s_journal_entry &entry); //read the entry at index (0 is the oldest) without removing it (return false if there is no entry)
+      uint8_t readJournal(d7s_journal_entry &entry); //read and remove the oldest entry (return false if the journal is empty)
+      void clearJournal(); //remove all the entries
+      uint16_t getJournalOverflowCount(); //return how many entries have been overwritten because the journal was full
+
+      //--- I2C BUS ---
+      void setBusRecoveryTimeout(uint16_t timeout); //set the max time [ms] spent recovering a stuck bus
+      d7s_bus_status getBusStatus(); //return the status of the lastest transaction
+      uint8_t recoverBus(); //try to release a stuck bus (return true if the bus is free)
+      uint16_t getBusErrorCount(); //return how many transactions failed after all the retries
+      uint16_t getBusStuckCount(); //return how many times the bus has been found stuck
+      uint16_t getBusRecoveryCount(); //return how many times the bus has been recovered
+      void resetBusCounters(); //reset the bus counters
 
    private:
-      //handler array (it cointaint the pointer to the user defined array)
-      void (*_handlers[4]) ();
-
-      //variable to track event (first bit => SHUTOFF, second bit => COLLAPSE)
+      //kind of handler registered (it tells which pointer of the handler union is in use)
+      enum d7s_handler_kind {
+         HANDLER_NONE = 0, //free slot
+         HANDLER_SIMPLE = 1, //void (*) ()
+         HANDLER_FLOAT = 2, //void (*) (float, float, float)
+         HANDLER_EVENT = 3, //d7s_event_handler
+         HANDLER_EARTHQUAKE = 4 //d7s_earthquake_handler
+      };
+
+      //registered handler
+      struct d7s_handler_entry {
+         uint8_t kind; //kind of handler (HANDLER_NONE if the slot is free)
+         uint8_t event; //event handled
+         union {
+            void (*simple) ();
+            void (*floats) (float, float, float);
+            d7s_event_handler event;
+            d7s_earthquake_handler earthquake;
+         } handler;
+         void *context; //user defined context
+      };
+
+      //handler table (it cointaint the handlers registered by the user)
+      d7s_handler_entry _handlers[D7S_MAX_HANDLERS];
+
+      //variable to track event (first bit => SHUTOFF, second bit => COLLAPSE, third bit => SELFTEST ERROR, fourth bit => OFFSET ERROR)
       uint8_t _events;
 
+      //true if an earthquake is in progress (tracked on INT2)
+      volatile uint8_t _earthquakeOccuring;
+      //INT2 edge filter
+      uint16_t _int2MinPulseWidth; //min time [us] INT2 must keep the new level
+      volatile uint16_t _int2Filtered; //edges filtered
+      volatile uint8_t _int2Busy; //true while an INT2 edge is handled (nested edges are handled by it)
+      uint8_t _int2Attached; //true if INT2 has been enabled
+      volatile uint8_t _int2Mode; //true while INT2 is low for the installation/offset/selftest mode (not an earthquake)
+
+      //true if the earthquake found by the warm start must be resumed when the interrupt handling starts
+      uint8_t _resumeEarthquake;
+
+      //time to ready
+      unsigned long _beginTime; //millis() at the first begin()
+      uint8_t _begun; //true if begin() has been called
+      uint32_t _timeToReady; //[ms] from the first begin() to the first ready state
+      uint8_t _readySeen; //true if the ready state has been seen
+
       //enable interrupt handling
       uint8_t _interruptEnabled;
 
+      //event journal (circular buffer)
+      d7s_journal_entry _journal[D7S_JOURNAL_SIZE];
+      volatile uint8_t _journalHead; //index of the oldest entry
+      volatile uint8_t _journalCount; //number of entries
+      volatile uint16_t _journalOverflow; //entries overwritten
+
+      //statistics of the current window (fixed point, updated by the INT2 handler)
+      volatile uint16_t _statCount; //earthquakes occured
+      volatile uint32_t _statSumSI; //sum of the SI [mm/s]
+      volatile uint16_t _statMaxSI; //max SI [mm/s]
+      volatile uint16_t _statMaxPGA; //max PGA [mm/s^2]
+      volatile uint16_t _peakPGA; //peak of the instantaneus PGA of the current earthquake [mm/s^2]
+
+      //telemetry frames
+      uint16_t _nodeId; //node id written into each frame
+      uint8_t _frameSequence; //sequence number of the next frame
+
+      //i2c bus state
+      d7s_bus_status _busStatus; //status of the lastest transaction
+      uint16_t _busRecoveryTimeout; //max time [ms] spent recovering a stuck bus
+      uint16_t _busErrorCount; //transactions failed after all the retries
+      uint16_t _busStuckCount; //times the bus has been found stuck
+      uint16_t _busRecoveryCount; //times the bus has been recovered
+      uint8_t _busRecovering; //true while re-syncing the sensor after a recovery (prevent nested recoveries)
+
       //--- READ ---
       uint8_t read8bit(uint8_t regH, uint8_t regL); //read 8 bit from the specified register
       uint16_t read16bit(uint8_t regH, uint8_t regL); //read 16 bit from the specified register
+      uint8_t readRegister(uint8_t regH, uint8_t regL, uint8_t *data, uint8_t len, uint8_t settle = 1, uint8_t attempts = D7S_I2C_RETRIES, unsigned long deadline = 0); //read len bytes starting from the specified register (return true on success)
 
       //--- WRITE ---
-      void write8bit(uint8_t regH, uint8_t regL, uint8_t val); //write 8 bit to the register specified
+      uint8_t write8bit(uint8_t regH, uint8_t regL, uint8_t val, uint8_t settle = 1); //write 8 bit to the register specified (return true on success)
+
+      //--- I2C BUS ---
+      void beginWire(uint16_t timeout = D7S_I2C_TIMEOUT); //(re)initialize Wire (timeout [ms] of the Wire transactions where supported)
+      void setWireTimeout(uint16_t timeout); //set the timeout [ms] of the Wire transactions where supported
+      uint8_t setWireDeadline(unsigned long deadline); //bound the next Wire transaction by the deadline [ms] (return false if it is over)
+      uint8_t checkBus(uint8_t &recovered); //check if the bus is stuck after a failed transaction and try to recover it once (return false if the transaction must give up)
+      uint8_t waitSCL(unsigned long start); //wait until SCL is released by the slaves (return false on timeout)
+
+      //--- READ EARTHQUAKE ---
+      d7s_earthquake readEarthquake(uint8_t regH); //read the earthquake data stored at the specified register (0x30 - 0x39)
+
+      //--- STATISTICS ---
+      static d7s_jma_intensity jmaIntensity(uint16_t si); //estimate the JMA seismic intensity from the SI [mm/s]
+      void updatePeakPGA(uint16_t pga); //update the peak of the instantaneus PGA of the current earthquake [mm/s^2]
+      static uint16_t toFixedPoint(float value); //convert a value to thousandths (saturated to 16 bit)
+
+      //--- TELEMETRY FRAMES ---
+      uint8_t encodeFrame(uint8_t *frame, uint8_t type, const uint8_t *payload, uint8_t len); //write header, payload and CRC-8 into the frame (return the frame size)
+
+      //--- READY STATE ---
+      void updateReady(d7s_status state); //save the time to ready the first time the D7S is ready
 
       //--- READ EVENTS ---
-      void readEvents(); //read the event (SHUTOFF/COLLAPSE) from the EVENT register
+      void readEvents(); //read the event (SHUTOFF/COLLAPSE/SELFTEST ERROR/OFFSET ERROR) from the EVENT register
 
       //--- EVENT HANDLER ---
-      void int1(); //handle the INT1 events
-      void int2(); //handle the INT2 events
+      void int1(uint32_t edgeTime); //handle the INT1 events (edgeTime is micros() at the edge)
+      void int2(uint32_t edgeTime); //handle the INT2 events (edgeTime is micros() at the edge)
+
+      //--- EVENT JOURNAL ---
+      void journal(uint32_t edgeTime, uint32_t resolvedTime, d7s_interrupt_event event, d7s_status state, uint8_t flags = 0); //add an entry to the journal (the dispatch ends now)
+
+      //--- INT2 EDGE FILTER ---
+      uint8_t debounceINT2(); //wait until INT2 keeps the same level for the min pulse width and return it
+      uint8_t trackINT2(uint32_t edgeTime); //follow the transitions of INT2 until it agrees with the tracked state (return how many)
+      uint8_t confirmEarthquake(); //confirm on STATE the earthquake signaled by a low INT2 (it's low in installation/offset/selftest mode too)
+      uint8_t isINT2Low(); //return true if the tracked level of INT2 is low
+      void armINT2(); //arm INT2 for the next edge (Fishino32 only: it cannot handle CHANGE mode on interrupts)
+
+      //--- HANDLERS ---
+      d7s_handler_entry *allocateHandler(d7s_interrupt_event event); //return a free slot of the handler table (NULL if there is no room), to be called in a critical section
+      d7s_handler_entry *replaceLegacyHandler(d7s_interrupt_event event); //remove the handler assigned with the old interface and return a free slot (NULL if there is no room), to be called in a critical section
+      void dispatch(d7s_interrupt_event event, const d7s_earthquake *earthquake); //call all the handlers of the event
 
       //--- ISR HANDLER ---
       static void isr1(); //it handle the FALLING event that occur to the INT1 D7S pin (glue routine)
       static void isr2(); //it handle the CHANGE event thant occur to the INT2 D7S pin (glue routine)
 
-      // Fishino32 cannot handle CHANGE mode on interrupts, so we need to register FALLING mode first and on the isr register
-      // as RISING the same pin detaching the previus interrupt
-      #if defined(_FISHINO_PIC32_) || defined(_FISHINO32_) || defined(_FISHINO32_120_) || defined(_FISHINO32_MX470F512H_) || defined(_FISHINO32_MX470F512H_120_)
-         uint8_t pinINT2;
-      #endif
+      //pin of INT2 (its level tells if the edge is the start or the end of an earthquake)
+      //Fishino32 also needs it to swap FALLING and RISING mode since it cannot handle CHANGE mode on interrupts
+      uint8_t pinINT2;
 
 };
 